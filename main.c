@@ -6,8 +6,15 @@
 #include <taihen.h>
 //#include "log.h"
 
+// Thread yield policy of camera reads
+#define READ_YIELD_NEVER   0
+#define READ_YIELD_ALWAYS  1 // Avoids freezing some games (Frobisher Says)
+#define READ_YIELD_NO_WAIT 2 // Only reads which don't sleep until the next frame
+
 #ifdef ENABLE_BMP
 #include <psp2/io/fcntl.h>
+#include <psp2/io/stat.h>
+#include <psp2/io/dirent.h>
 #include <psp2/appmgr.h>
 #include <psp2/kernel/sysmem.h>
 
@@ -21,6 +28,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
 // Structure to simulate SceCamera API alternative behavior
 typedef struct SceCameraRead2 {
 	SceSize size; //!< sizeof(SceCameraRead2)
@@ -76,6 +87,234 @@ unsigned int alignSizeForMemBlock(unsigned int size)
     return size;
 }
 
+#define abs(val) ((val < 0) ? -val : val)
+#define sign(val) ((val > 0) ? 1 : ((val < 0) ? -1 : 0))
+#define clamp(val, min, max) ((val > max) ? max : ((val < min) ? min : val))
+
+// File access (kernel calls through kuio for "fakecamerakbmp.suprx")
+
+static SceUID OpenFile(const char* iPath)
+{
+#ifdef READ_WITH_KUIO
+    SceUID fd = -1;
+    kuIoOpen(iPath, SCE_O_RDONLY, &fd);
+    return fd;
+#else
+    return sceIoOpen(iPath, SCE_O_RDONLY, 0666);
+#endif
+}
+
+static int ReadFile(SceUID iFile, void* oData, SceSize iSize)
+{
+#ifdef READ_WITH_KUIO
+    return kuIoRead(iFile, oData, iSize);
+#else
+    return sceIoRead(iFile, oData, iSize);
+#endif
+}
+
+static void SeekFile(SceUID iFile, unsigned int iOffset)
+{
+#ifdef READ_WITH_KUIO
+    kuIoLseek(iFile, iOffset, SCE_SEEK_SET);
+#else
+    sceIoLseek(iFile, iOffset, SCE_SEEK_SET);
+#endif
+}
+
+static void CloseFile(SceUID iFile)
+{
+#ifdef READ_WITH_KUIO
+    kuIoClose(iFile);
+#else
+    sceIoClose(iFile);
+#endif
+}
+
+// File names comparison ignoring case (as the memory card file system does)
+static int SameNameNoCase(const char* iName1, const char* iName2)
+{
+    for (; '\0' != *iName1 && '\0' != *iName2; iName1++, iName2++)
+    {
+        char c1 = ('A' <= *iName1 && *iName1 <= 'Z') ? *iName1 - 'A' + 'a' : *iName1;
+        char c2 = ('A' <= *iName2 && *iName2 <= 'Z') ? *iName2 - 'A' + 'a' : *iName2;
+        if (c1 != c2)
+            return 0;
+    }
+    return (*iName1 == *iName2);
+}
+
+static int HasExtension(const char* iName, const char* iExtension)
+{
+    int length = strlen(iName);
+    return (length > 4 && SameNameNoCase(iName + length - 4, iExtension));
+}
+
+// Plugin configuration read from "ux0:data/FakeCamera/TITLEID00.cfg" or else "ux0:data/FakeCamera/ALL.cfg"
+// Each line is a "name=value" pair with an integer value, lines starting with '#' are ignored
+
+#define MAX_VIDEO_RING_FRAMES 8
+
+#define IMAGE_SCALING_NONE    0 // Images larger than camera buffers are cropped, smaller ones have black borders
+#define IMAGE_SCALING_FIT     1 // Whole image shown with black borders, aspect ratio kept
+#define IMAGE_SCALING_FILL    2 // Camera buffers covered with a cropped image, aspect ratio kept
+#define IMAGE_SCALING_STRETCH 3 // Image resized to camera resolution
+
+#define SCALING_FILTER_NEAREST  0
+#define SCALING_FILTER_BILINEAR 1
+#define SCALING_FILTER_BOX      2 // Average of covered pixels when the image is reduced (bilinear otherwise)
+
+// Color filter of RAW8 images, named after the top-left 2x2 block
+#define BAYER_PATTERN_RGGB 0
+#define BAYER_PATTERN_GRBG 1
+#define BAYER_PATTERN_GBRG 2
+#define BAYER_PATTERN_BGGR 3
+
+typedef struct {
+    int loadChunkRows; // BMP rows read at once while loading an image
+    int imageCache;       // Converted images are kept in "ux0:data/FakeCamera/cache" when not 0
+    int imageMemoryLimit; // Kilobytes of BMP pixels and converted images kept in memory for each BMP file
+    int memoryArena;      // Kilobytes of the memory block shared by images (0 for a memory block per image plane)
+    int videoRingFrames;  // Video frames converted ahead of time
+    int videoFiles;       // Video files are looked for before BMP files when not 0
+    int frameProducer;    // Camera frames are rendered by a helper thread when not 0
+    int imageScaling;     // Images resampling to camera resolution (IMAGE_SCALING_*)
+    int scalingFilter;    // Resampling filter (SCALING_FILTER_*)
+    int bayerPattern;     // Color filter of RAW8 images (BAYER_PATTERN_*)
+    int motionRate;       // Motion samples per second taken by a helper thread (0 to sample motion on each new frame)
+    int motionSmoothing;  // Percentage of the previous motion kept by each sample (low-pass filter)
+    int readYield;        // Thread yield policy of camera reads (READ_YIELD_*)
+    int readPacing;       // Blocking camera reads end half a frame after the frame start at the earliest when not 0
+    int virtualClock;     // Camera time advances by one frame on each camera read when not 0
+    int trace;            // Camera events are recorded in TRACE_PATH when not 0
+} PluginConfig;
+
+static PluginConfig config = {
+    32,   // loadChunkRows
+    1,    // imageCache
+    0,    // imageMemoryLimit
+    0,    // memoryArena
+    3,    // videoRingFrames
+    1,    // videoFiles
+    0,    // frameProducer
+    0,    // imageScaling
+    1,    // scalingFilter
+    BAYER_PATTERN_RGGB, // bayerPattern
+    60,   // motionRate
+    0,    // motionSmoothing
+    READ_YIELD_ALWAYS, // readYield
+    0,    // readPacing
+    0,    // virtualClock
+    0,    // trace
+};
+
+typedef struct {
+    const char* name;
+    int* value;
+} ConfigEntry;
+
+static const ConfigEntry configEntries[] = {
+    { "loadChunkRows", &config.loadChunkRows },
+    { "imageCache", &config.imageCache },
+    { "imageMemoryLimit", &config.imageMemoryLimit },
+    { "memoryArena", &config.memoryArena },
+    { "videoRingFrames", &config.videoRingFrames },
+    { "videoFiles", &config.videoFiles },
+    { "frameProducer", &config.frameProducer },
+    { "imageScaling", &config.imageScaling },
+    { "scalingFilter", &config.scalingFilter },
+    { "bayerPattern", &config.bayerPattern },
+    { "motionRate", &config.motionRate },
+    { "motionSmoothing", &config.motionSmoothing },
+    { "readYield", &config.readYield },
+    { "readPacing", &config.readPacing },
+    { "virtualClock", &config.virtualClock },
+    { "trace", &config.trace },
+};
+
+static char* TrimSpaces(char* iText)
+{
+    while (' ' == *iText || '\t' == *iText)
+        iText++;
+    char* end = iText + strlen(iText);
+    while (end > iText && (' ' == end[-1] || '\t' == end[-1] || '\r' == end[-1]))
+        *--end = '\0';
+    return iText;
+}
+
+static int ParseInt(const char* iText)
+{
+    int sign = 1;
+    int value = 0;
+    if ('-' == *iText)
+    {
+        sign = -1;
+        iText++;
+    }
+    while (*iText >= '0' && *iText <= '9')
+        value = value*10 + (*iText++ - '0');
+    return sign*value;
+}
+
+static void ParseConfig(char* iText, const ConfigEntry* iEntries, unsigned int iEntryCount)
+{
+    char* line = iText;
+    while ('\0' != *line)
+    {
+        char* next = line;
+        while ('\0' != *next && '\n' != *next)
+            next++;
+        if ('\0' != *next)
+            *next++ = '\0';
+
+        char* separator = strchr(line, '=');
+        line = TrimSpaces(line);
+        if ('#' != line[0] && NULL != separator)
+        {
+            *separator = '\0';
+            char* name = TrimSpaces(line);
+            for (int i = 0; i < iEntryCount; i++)
+            {
+                if (0 == strcmp(name, iEntries[i].name))
+                    *iEntries[i].value = ParseInt(TrimSpaces(separator+1));
+            }
+        }
+        line = next;
+    }
+}
+
+static void LoadConfig(const char* iTitleId)
+{
+    static char text[2048];
+    char pathname[64];
+    sprintf(pathname, "ux0:/data/FakeCamera/%s.cfg", iTitleId);
+    SceUID fd = OpenFile(pathname);
+    if (fd < 0)
+        fd = OpenFile("ux0:/data/FakeCamera/ALL.cfg");
+    if (fd < 0)
+        return;
+
+    int size = ReadFile(fd, text, sizeof(text)-1);
+    CloseFile(fd);
+    if (size <= 0)
+        return;
+    text[size] = '\0';
+    ParseConfig(text, configEntries, sizeof(configEntries)/sizeof(configEntries[0]));
+
+    // Chunks must hold whole YUV420 row pairs
+    config.loadChunkRows = clamp(config.loadChunkRows, 2, 512) & ~1;
+    if (config.imageMemoryLimit < 0)
+        config.imageMemoryLimit = 0;
+    config.memoryArena = clamp(config.memoryArena, 0, 65536);
+    config.videoRingFrames = clamp(config.videoRingFrames, 2, MAX_VIDEO_RING_FRAMES);
+    config.imageScaling = clamp(config.imageScaling, IMAGE_SCALING_NONE, IMAGE_SCALING_STRETCH);
+    config.scalingFilter = clamp(config.scalingFilter, SCALING_FILTER_NEAREST, SCALING_FILTER_BOX);
+    config.bayerPattern = clamp(config.bayerPattern, BAYER_PATTERN_RGGB, BAYER_PATTERN_BGGR);
+    config.motionRate = clamp(config.motionRate, 0, 1000);
+    config.motionSmoothing = clamp(config.motionSmoothing, 0, 95);
+    config.readYield = clamp(config.readYield, READ_YIELD_NEVER, READ_YIELD_NO_WAIT);
+}
+
 typedef struct {
     SceUID blockIDs[3];
     void* blocksData[3];
@@ -89,1224 +328,3642 @@ typedef struct {
     int ready;
 } ImageBuffers;
 
-typedef void (*BufferWriteFunc)(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor);
+#define IMAGE_BUFFERS_INIT { {-1, -1, -1}, {NULL, NULL, NULL}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, 0, 0, 0, 0, -1 }
 
-// Camera formats support
+// Fixed-point RGB to YUV conversion (same coefficients as the former float matrix, 15 fractional bits)
+// Coefficients fit in 16 bits so that sums of up to 4 pixels never overflow 32-bit accumulators
 
-static void ABGRWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+#define YUV_FIX_SHIFT 15
+
+static const int yuvMat[3][3] = { {9798, 19235, 3735}, {-4691, -9465, 14287}, {20152, -16875, -3277} };
+
+static inline unsigned char clampByte(int val)
+{
+    return (val < 0) ? 0 : ((val > 255) ? 255 : val);
+}
+
+static inline unsigned char RGBChannelsToY(int iR, int iG, int iB)
 {
-    ((unsigned int*)oBuffers->blocksData[0])[iGlobalPos] = iColor;
+    return clampByte((yuvMat[0][0]*iR + yuvMat[0][1]*iG + yuvMat[0][2]*iB + (1<<(YUV_FIX_SHIFT-1))) >> YUV_FIX_SHIFT);
 }
 
-static void ARGBWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+// Averaged chroma of (1<<iCountShift) pixels given their summed channels (iRow: 1 for U, 2 for V)
+static inline unsigned char RGBSumToUV(int iRow, int iSumR, int iSumG, int iSumB, int iCountShift)
 {
-    ((unsigned int*)oBuffers->blocksData[0])[iGlobalPos] = (iColor&0xFF00FF00) | (iColor&0xFF)<<16 | (iColor&0xFF0000)>>16;
+    int shift = YUV_FIX_SHIFT + iCountShift;
+    int val = yuvMat[iRow][0]*iSumR + yuvMat[iRow][1]*iSumG + yuvMat[iRow][2]*iSumB + (128<<shift) + (1<<(shift-1));
+    return clampByte(val >> shift);
 }
 
-float convMat[3][3] = { {0.299f, 0.587f, 0.114f}, {-0.14317f, -0.28886f, 0.436f}, {0.615f, -0.51499f, -0.10001f} };
+// Row conversion kernels
+// Source rows are BMP pixels (BGR565, BGR888 or BGRA8888 depending on iSrcBits) and widths are even for YUV formats
+// Kernels are always inlined with a constant iSrcBits so that each (bit depth, camera format) pair gets its own loop
+// NEON paths handle 16 pixels per iteration and leave the remainder to the scalar code, both giving the same output
 
-typedef struct {
-    unsigned int globalPos;
-    unsigned int colors[2];
-} YUV422Data;
+#define FORCE_INLINE static inline __attribute__((always_inline))
 
-static void RGBToYUV422(YUV422Data* iData, float Y[2], float Cb[2], float Cr[2])
+// BGR565 channels expansion to 8 bits (high bits replicated in low bits)
+static const unsigned char expand5[32] = {
+    0, 8, 16, 24, 33, 41, 49, 57, 66, 74, 82, 90, 99, 107, 115, 123,
+    132, 140, 148, 156, 165, 173, 181, 189, 198, 206, 214, 222, 231, 239, 247, 255 };
+static const unsigned char expand6[64] = {
+    0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60,
+    65, 69, 73, 77, 81, 85, 89, 93, 97, 101, 105, 109, 113, 117, 121, 125,
+    130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190,
+    195, 199, 203, 207, 211, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255 };
+
+FORCE_INLINE void ReadPixel(const unsigned char* iSrc, unsigned int iSrcBits, unsigned int iX, int* oR, int* oG, int* oB, int* oA)
 {
-    for (int i = 0; i < 2; i++)
+    if (16 == iSrcBits)
     {
-        unsigned int color = iData->colors[i];
-        float nR = (float)(color&0xFF);
-        float nG = (float)((color&0xFF00)>>8);
-        float nB = (float)((color&0xFF0000)>>16);
-        
-        Y[i] = convMat[0][0] * nR + convMat[0][1] * nG + convMat[0][2] * nB;
-        Cb[i] = convMat[1][0] * nR + convMat[1][1] * nG + convMat[1][2] * nB + 128.f;
-        Cr[i] = convMat[2][0] * nR + convMat[2][1] * nG + convMat[2][2] * nB + 128.f;
+        unsigned int color = ((const unsigned short*)iSrc)[iX];
+        *oB = expand5[color&0x1F];
+        *oG = expand6[(color>>5)&0x3F];
+        *oR = expand5[color>>11];
+        *oA = 0xFF;
     }
-}
-
-static void YUV422PackedWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
-{
-    YUV422Data* data = (YUV422Data*)iFuncData;
-    if (0 == iWidthPos%2)
+    else
     {
-        data->globalPos = iGlobalPos;
-        data->colors[0] = iColor;
-        return;
+        const unsigned char* pixel = iSrc + iX*(iSrcBits/8);
+        *oB = pixel[0];
+        *oG = pixel[1];
+        *oR = pixel[2];
+        *oA = (32 == iSrcBits) ? pixel[3] : 0xFF;
     }
-    data->colors[1] = iColor;
-    
-    float Y[2];
-    float Cb[2];
-    float Cr[2];
-    RGBToYUV422(data, Y, Cb, Cr);
+}
 
-    ((unsigned short*)oBuffers->blocksData[0])[data->globalPos] = (((unsigned char)Y[0])<<8) | (unsigned char)((Cb[0]+Cb[1])/2.f);
-    ((unsigned short*)oBuffers->blocksData[0])[iGlobalPos] = (((unsigned char)Y[1])<<8) | (unsigned char)((Cr[0]+Cr[1])/2.f);
+#ifdef __ARM_NEON
+FORCE_INLINE uint8x8_t NeonExpand565(uint16x8_t iColors, int iShift, int iBits)
+{
+    uint16x8_t channel = vandq_u16(vshlq_u16(iColors, vdupq_n_s16(-iShift)), vdupq_n_u16((1<<iBits)-1));
+    channel = vorrq_u16(vshlq_u16(channel, vdupq_n_s16(8-iBits)), vshlq_u16(channel, vdupq_n_s16(8-2*iBits)));
+    return vmovn_u16(channel);
 }
 
-static void YUV422PlaneWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+FORCE_INLINE uint8x16x4_t NeonLoadBGRA(const unsigned char* iSrc, unsigned int iSrcBits)
 {
-    YUV422Data* data = (YUV422Data*)iFuncData;
-    if (0 == iWidthPos%2)
+    uint8x16x4_t pix;
+    if (32 == iSrcBits)
+        pix = vld4q_u8(iSrc);
+    else if (24 == iSrcBits)
     {
-        data->globalPos = iGlobalPos;
-        data->colors[0] = iColor;
-        return;
+        uint8x16x3_t bgr = vld3q_u8(iSrc);
+        pix.val[0] = bgr.val[0];
+        pix.val[1] = bgr.val[1];
+        pix.val[2] = bgr.val[2];
+        pix.val[3] = vdupq_n_u8(0xFF);
     }
-    data->colors[1] = iColor;
-    
-    float Y[2];
-    float Cb[2];
-    float Cr[2];
-    RGBToYUV422(data, Y, Cb, Cr);
+    else
+    {
+        uint16x8_t lo = vld1q_u16((const uint16_t*)iSrc);
+        uint16x8_t hi = vld1q_u16((const uint16_t*)iSrc + 8);
+        pix.val[0] = vcombine_u8(NeonExpand565(lo, 0, 5), NeonExpand565(hi, 0, 5));
+        pix.val[1] = vcombine_u8(NeonExpand565(lo, 5, 6), NeonExpand565(hi, 5, 6));
+        pix.val[2] = vcombine_u8(NeonExpand565(lo, 11, 5), NeonExpand565(hi, 11, 5));
+        pix.val[3] = vdupq_n_u8(0xFF);
+    }
+    return pix;
+}
 
-    ((unsigned char*)oBuffers->blocksData[0])[data->globalPos] = (unsigned char)Y[0];
-    ((unsigned char*)oBuffers->blocksData[0])[iGlobalPos] = (unsigned char)Y[1];
-    ((unsigned char*)oBuffers->blocksData[1])[data->globalPos/2] = (unsigned char)((Cb[0]+Cb[1])/2.f);
-    ((unsigned char*)oBuffers->blocksData[2])[data->globalPos/2] = (unsigned char)((Cr[0]+Cr[1])/2.f);
+FORCE_INLINE int32x4_t NeonMatRow(int iRow, int32x4_t iAcc, int16x4_t iR, int16x4_t iG, int16x4_t iB)
+{
+    iAcc = vmlal_n_s16(iAcc, iR, yuvMat[iRow][0]);
+    iAcc = vmlal_n_s16(iAcc, iG, yuvMat[iRow][1]);
+    return vmlal_n_s16(iAcc, iB, yuvMat[iRow][2]);
 }
 
-typedef struct {
-    unsigned int globalPos[2];
-    unsigned int colors[4];
-} YUV420Data;
+// Same arithmetic as RGBChannelsToY/RGBSumToUV on 8 lanes (channels or channel sums of up to 4 pixels)
+FORCE_INLINE uint8x8_t NeonMat(int iRow, uint16x8_t iR, uint16x8_t iG, uint16x8_t iB, int iCountShift)
+{
+    int shift = YUV_FIX_SHIFT + iCountShift;
+    int32x4_t bias = vdupq_n_s32(((0 == iRow) ? 0 : (128<<shift)) + (1<<(shift-1)));
+    int32x4_t rshift = vdupq_n_s32(-shift);
+    int16x8_t r = vreinterpretq_s16_u16(iR);
+    int16x8_t g = vreinterpretq_s16_u16(iG);
+    int16x8_t b = vreinterpretq_s16_u16(iB);
+    int32x4_t lo = NeonMatRow(iRow, bias, vget_low_s16(r), vget_low_s16(g), vget_low_s16(b));
+    int32x4_t hi = NeonMatRow(iRow, bias, vget_high_s16(r), vget_high_s16(g), vget_high_s16(b));
+    lo = vshlq_s32(lo, rshift);
+    hi = vshlq_s32(hi, rshift);
+    return vqmovn_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)));
+}
+
+FORCE_INLINE uint8x16_t NeonY(uint8x16x4_t iPix)
+{
+    uint8x8_t lo = NeonMat(0, vmovl_u8(vget_low_u8(iPix.val[2])), vmovl_u8(vget_low_u8(iPix.val[1])), vmovl_u8(vget_low_u8(iPix.val[0])), 0);
+    uint8x8_t hi = NeonMat(0, vmovl_u8(vget_high_u8(iPix.val[2])), vmovl_u8(vget_high_u8(iPix.val[1])), vmovl_u8(vget_high_u8(iPix.val[0])), 0);
+    return vcombine_u8(lo, hi);
+}
+#endif
 
-static void RGBToYUV420(YUV420Data* iData, float Y[4], float Cb[4], float Cr[4])
+FORCE_INLINE void RowToABGR(const unsigned char* iSrc, unsigned int iSrcBits, unsigned char* oDst, unsigned int iWidth)
 {
-    for (int i = 0; i < 4; i++)
+    unsigned int x = 0;
+#ifdef __ARM_NEON
+    for (; x+16 <= iWidth; x += 16)
     {
-        unsigned int color = iData->colors[i];
-        float nR = (float)(color&0xFF);
-        float nG = (float)((color&0xFF00)>>8);
-        float nB = (float)((color&0xFF0000)>>16);
-        
-        Y[i] = convMat[0][0] * nR + convMat[0][1] * nG + convMat[0][2] * nB;
-        Cb[i] = convMat[1][0] * nR + convMat[1][1] * nG + convMat[1][2] * nB + 128.f;
-        Cr[i] = convMat[2][0] * nR + convMat[2][1] * nG + convMat[2][2] * nB + 128.f;
+        uint8x16x4_t pix = NeonLoadBGRA(iSrc+x*iSrcBits/8, iSrcBits);
+        uint8x16_t blue = pix.val[0];
+        pix.val[0] = pix.val[2];
+        pix.val[2] = blue;
+        vst4q_u8(oDst+x*4, pix);
+    }
+#endif
+    for (; x < iWidth; x++)
+    {
+        int r, g, b, a;
+        ReadPixel(iSrc, iSrcBits, x, &r, &g, &b, &a);
+        unsigned char* dst = oDst + x*4;
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
     }
 }
 
-static void YUV420PlaneWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+FORCE_INLINE void RowToARGB(const unsigned char* iSrc, unsigned int iSrcBits, unsigned char* oDst, unsigned int iWidth)
 {
-    YUV420Data* data = (YUV420Data*)iFuncData;
-    unsigned int pixelPosInBlock = iWidthPos%2+((iHeightPos%2)<<1);
-    if (0 == iWidthPos%2)
-        data->globalPos[iHeightPos%2] = iGlobalPos;
-    data->colors[pixelPosInBlock] = iColor;
-    if (pixelPosInBlock < 3)
+    // ARGB texels have the same byte order as BGRA8888 pixels
+    if (32 == iSrcBits)
+    {
+        memcpy(oDst, iSrc, iWidth*4);
         return;
-    
-    float Y[4];
-    float Cb[4];
-    float Cr[4];
-    RGBToYUV420(data, Y, Cb, Cr);
+    }
 
-    ((unsigned short*)oBuffers->blocksData[0])[data->globalPos[0]/2] = (unsigned char)Y[0] | (((unsigned char)Y[1])<<8);
-    ((unsigned short*)oBuffers->blocksData[0])[data->globalPos[1]/2] = (unsigned char)Y[2] | (((unsigned char)Y[3])<<8);
-    ((unsigned char*)oBuffers->blocksData[1])[(data->globalPos[1]+(iWidthPos-1))/4] = (unsigned char)((Cb[0]+Cb[1]+Cb[2]+Cb[3])/4.f);
-    ((unsigned char*)oBuffers->blocksData[2])[(data->globalPos[1]+(iWidthPos-1))/4] = (unsigned char)((Cr[0]+Cr[1]+Cr[2]+Cr[3])/4.f);
+    unsigned int x = 0;
+#ifdef __ARM_NEON
+    for (; x+16 <= iWidth; x += 16)
+        vst4q_u8(oDst+x*4, NeonLoadBGRA(iSrc+x*iSrcBits/8, iSrcBits));
+#endif
+    for (; x < iWidth; x++)
+    {
+        int r, g, b, a;
+        ReadPixel(iSrc, iSrcBits, x, &r, &g, &b, &a);
+        unsigned char* dst = oDst + x*4;
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+        dst[3] = a;
+    }
 }
 
-// Bitmap reading functions
-
-static unsigned int ReadColor(void* buffer, unsigned short bitCount, unsigned int row_stride, int col, int row)
+// Converts pixels iX and iX+1 to their luma values and summed channels
+FORCE_INLINE void PairToYUV(const unsigned char* iSrc, unsigned int iSrcBits, unsigned int iX, unsigned char oY[2], int oSum[3])
 {
-    unsigned int imgColor = 0;
-    if (bitCount == 32) {		//BGRA8888
-        unsigned int color = *(unsigned int *)(buffer + row*row_stride + col*4);
-        imgColor = ((color>>24)&0xFF)<<24 | (color&0xFF)<<16 |
-            ((color>>8)&0xFF)<<8 | ((color>>16)&0xFF);
-
-    } else if (bitCount == 24) {	//BGR888
-        unsigned char *address = buffer + row*row_stride + col*3;
-        imgColor = (*address)<<16 | (*(address+1))<<8 |
-            (*(address+2)) | (0xFF<<24);
+    int r0, g0, b0, r1, g1, b1, a;
+    ReadPixel(iSrc, iSrcBits, iX, &r0, &g0, &b0, &a);
+    ReadPixel(iSrc, iSrcBits, iX+1, &r1, &g1, &b1, &a);
+    oY[0] = RGBChannelsToY(r0, g0, b0);
+    oY[1] = RGBChannelsToY(r1, g1, b1);
+    oSum[0] = r0 + r1;
+    oSum[1] = g0 + g1;
+    oSum[2] = b0 + b1;
+}
 
-    } else if (bitCount == 16) {	//BGR565
-        unsigned int color = *(unsigned short *)(buffer + row*row_stride + col*2);
-        unsigned char r = (color       & 0x1F)  *((float)255/31);
-        unsigned char g = ((color>>5)  & 0x3F)  *((float)255/63);
-        unsigned char b = ((color>>11) & 0x1F)  *((float)255/31);
-        imgColor = ((r<<16) | (g<<8) | b | (0xFF<<24));
+FORCE_INLINE void RowToYUV422Packed(const unsigned char* iSrc, unsigned int iSrcBits, unsigned char* oDst, unsigned int iWidth)
+{
+    unsigned int x = 0;
+#ifdef __ARM_NEON
+    for (; x+16 <= iWidth; x += 16)
+    {
+        uint8x16x4_t pix = NeonLoadBGRA(iSrc+x*iSrcBits/8, iSrcBits);
+        uint8x16_t luma = NeonY(pix);
+        uint8x8x2_t lumas = vuzp_u8(vget_low_u8(luma), vget_high_u8(luma));
+        uint16x8_t sumR = vpaddlq_u8(pix.val[2]);
+        uint16x8_t sumG = vpaddlq_u8(pix.val[1]);
+        uint16x8_t sumB = vpaddlq_u8(pix.val[0]);
+        uint8x8x4_t out;
+        out.val[0] = NeonMat(1, sumR, sumG, sumB, 1);
+        out.val[1] = lumas.val[0];
+        out.val[2] = NeonMat(2, sumR, sumG, sumB, 1);
+        out.val[3] = lumas.val[1];
+        vst4_u8(oDst+x*2, out);
+    }
+#endif
+    for (; x < iWidth; x += 2)
+    {
+        unsigned char Y[2];
+        int sum[3];
+        PairToYUV(iSrc, iSrcBits, x, Y, sum);
+        unsigned char* dst = oDst + x*2;
+        dst[0] = RGBSumToUV(1, sum[0], sum[1], sum[2], 1);
+        dst[1] = Y[0];
+        dst[2] = RGBSumToUV(2, sum[0], sum[1], sum[2], 1);
+        dst[3] = Y[1];
     }
-    return imgColor;
 }
 
-static int LoadBMPGeneric(BITMAPFILEHEADER *bmp_fh, BITMAPINFOHEADER *bmp_ih, SceUID iFile,
-                          ImageBuffers* oBuffers, BufferWriteFunc iWriteFunc, void* iFuncData)
-{    
-    unsigned int row_stride = bmp_ih->biWidth * (bmp_ih->biBitCount/8);
-    if (row_stride%4 != 0) {
-        row_stride += 4-(row_stride%4);
+FORCE_INLINE void RowToYUV422Plane(const unsigned char* iSrc, unsigned int iSrcBits, unsigned char* oY, unsigned char* oU, unsigned char* oV, unsigned int iWidth)
+{
+    unsigned int x = 0;
+#ifdef __ARM_NEON
+    for (; x+16 <= iWidth; x += 16)
+    {
+        uint8x16x4_t pix = NeonLoadBGRA(iSrc+x*iSrcBits/8, iSrcBits);
+        vst1q_u8(oY+x, NeonY(pix));
+        uint16x8_t sumR = vpaddlq_u8(pix.val[2]);
+        uint16x8_t sumG = vpaddlq_u8(pix.val[1]);
+        uint16x8_t sumB = vpaddlq_u8(pix.val[0]);
+        vst1_u8(oU+x/2, NeonMat(1, sumR, sumG, sumB, 1));
+        vst1_u8(oV+x/2, NeonMat(2, sumR, sumG, sumB, 1));
     }
-    unsigned int block_stride = row_stride * oBuffers->heightAlign;
-
-    unsigned int size = alignSizeForMemBlock(block_stride);
-    SceUID bufferID = sceKernelAllocMemBlock("bitmap_block", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, size, NULL);
-    void *buffer = NULL;
-    sceKernelGetMemBlockBase(bufferID, (void **)&buffer);
-    if (!buffer) {
-        return -1;
+#endif
+    for (; x < iWidth; x += 2)
+    {
+        int sum[3];
+        PairToYUV(iSrc, iSrcBits, x, oY+x, sum);
+        oU[x/2] = RGBSumToUV(1, sum[0], sum[1], sum[2], 1);
+        oV[x/2] = RGBSumToUV(2, sum[0], sum[1], sum[2], 1);
     }
+}
 
-#ifdef READ_WITH_KUIO
-    kuIoLseek(iFile, bmp_fh->bfOffBits, SCE_SEEK_SET);
-#else
-    sceIoLseek(iFile, bmp_fh->bfOffBits, SCE_SEEK_SET);
+FORCE_INLINE void RowPairToYUV420Plane(const unsigned char* iSrc0, const unsigned char* iSrc1, unsigned int iSrcBits,
+                                       unsigned char* oY0, unsigned char* oY1, unsigned char* oU, unsigned char* oV, unsigned int iWidth)
+{
+    unsigned int x = 0;
+#ifdef __ARM_NEON
+    for (; x+16 <= iWidth; x += 16)
+    {
+        uint8x16x4_t pix0 = NeonLoadBGRA(iSrc0+x*iSrcBits/8, iSrcBits);
+        uint8x16x4_t pix1 = NeonLoadBGRA(iSrc1+x*iSrcBits/8, iSrcBits);
+        vst1q_u8(oY0+x, NeonY(pix0));
+        vst1q_u8(oY1+x, NeonY(pix1));
+        uint16x8_t sumR = vpadalq_u8(vpaddlq_u8(pix0.val[2]), pix1.val[2]);
+        uint16x8_t sumG = vpadalq_u8(vpaddlq_u8(pix0.val[1]), pix1.val[1]);
+        uint16x8_t sumB = vpadalq_u8(vpaddlq_u8(pix0.val[0]), pix1.val[0]);
+        vst1_u8(oU+x/2, NeonMat(1, sumR, sumG, sumB, 2));
+        vst1_u8(oV+x/2, NeonMat(2, sumR, sumG, sumB, 2));
+    }
 #endif
-
-    unsigned int alignedWidth = oBuffers->imageWidth;
-    unsigned int alignedHeight = oBuffers->imageHeight;
-    unsigned int blocksCount = alignedHeight / oBuffers->heightAlign;
- 
-    int b, i, j, x, y;
-    if (oBuffers->heightAlign > 1)
+    for (; x < iWidth; x += 2)
     {
-        for (b = 0; b < blocksCount; b++)
-        {
-        #ifdef READ_WITH_KUIO
-            kuIoRead(iFile, buffer, block_stride);
-        #else
-            sceIoRead(iFile, buffer, block_stride);
-        #endif
+        int sum0[3];
+        int sum1[3];
+        PairToYUV(iSrc0, iSrcBits, x, oY0+x, sum0);
+        PairToYUV(iSrc1, iSrcBits, x, oY1+x, sum1);
+        oU[x/2] = RGBSumToUV(1, sum0[0]+sum1[0], sum0[1]+sum1[1], sum0[2]+sum1[2], 2);
+        oV[x/2] = RGBSumToUV(2, sum0[0]+sum1[0], sum0[1]+sum1[1], sum0[2]+sum1[2], 2);
+    }
+}
 
-            for (i = 0; i < alignedWidth; i+=oBuffers->widthAlign)
-            {
-                for (j = 0; j < oBuffers->heightAlign ; j++)
-                {
-                    y = b*oBuffers->heightAlign + j;
+// Component kept by each column of even and odd RAW8 rows for every BAYER_PATTERN_* (0 blue, 1 green, 2 red as in BMP
+// pixels bytes), so that a row is converted with a straight gather
+static const unsigned char bayerChannels[4][2][2] = {
+    { {2, 1}, {1, 0} }, // RGGB
+    { {1, 2}, {0, 1} }, // GRBG
+    { {1, 0}, {2, 1} }, // GBRG
+    { {0, 1}, {1, 2} }, // BGGR
+};
 
-                    for (x = i; x < i+oBuffers->widthAlign; x++)
-                    {
-                        unsigned int globalPos = (alignedHeight - 1 - y)*alignedWidth + x;
-                        unsigned int imgColor = ReadColor(buffer, bmp_ih->biBitCount, row_stride, x, j);
-                        iWriteFunc(iFuncData, oBuffers, globalPos, x, y, imgColor);
-                    }
-                }
-            }
+FORCE_INLINE void RowToRAW8(const unsigned char* iSrc, unsigned int iSrcBits, unsigned char* oDst, unsigned int iWidth, const unsigned char iChannels[2])
+{
+    if (16 == iSrcBits)
+    {
+        for (unsigned int x = 0; x < iWidth; x++)
+        {
+            int bgra[4];
+            ReadPixel(iSrc, iSrcBits, x, &bgra[2], &bgra[1], &bgra[0], &bgra[3]);
+            oDst[x] = bgra[iChannels[x&1]];
         }
+        return;
     }
-    else
+
+    // Width is even
+    unsigned int bytes = iSrcBits/8;
+    const unsigned char* src0 = iSrc + iChannels[0];
+    const unsigned char* src1 = iSrc + bytes + iChannels[1];
+    for (unsigned int x = 0; x < iWidth; x += 2)
     {
-        for (i = 0; i < blocksCount; i++)
-        {
-        #ifdef READ_WITH_KUIO
-            kuIoRead(iFile, buffer, block_stride);
-        #else
-            sceIoRead(iFile, buffer, block_stride);
-        #endif
+        oDst[x] = src0[x*bytes];
+        oDst[x+1] = src1[x*bytes];
+    }
+}
 
-            for (j = 0; j < oBuffers->heightAlign ; j++)
-            {
-                y = i*oBuffers->heightAlign + j;
-                unsigned int globalPos = (alignedHeight - 1 - y)*alignedWidth;
+// Video frame conversion from 8 bits YUV 4:2:0 planes (iSrc holds the Y, U then V planes with top-down rows)
+// Samples are taken as full range like the BMP conversion, so YUV formats get them unchanged
 
-                for (x = 0; x < alignedWidth; x++)
-                {
-                    unsigned int imgColor = ReadColor(buffer, bmp_ih->biBitCount, row_stride, x, 0);
-                    iWriteFunc(iFuncData, oBuffers, globalPos, x, y, imgColor);
-                    globalPos++;
-                }
-            }
+typedef void (*VideoConvertFunc)(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers);
+
+// Inverse of yuvMat (16 fractional bits)
+#define RGB_FIX_SHIFT 16
+
+static const int rgbMatV[2] = { 74701, -37934 };  // V contributions to R and G
+static const int rgbMatU[2] = { -25861, 133178 }; // U contributions to G and B
+
+// Writes iWidth pixels of a video row, iRGBOffsets giving the byte offsets of R, G, B and A in a destination pixel
+static inline void VideoRowToRGBA(const unsigned char* iY, const unsigned char* iU, const unsigned char* iV, unsigned char* oDst, unsigned int iWidth, const int iRGBOffsets[4])
+{
+    for (int x = 0; x < iWidth; x += 2)
+    {
+        int u = iU[x/2] - 128;
+        int v = iV[x/2] - 128;
+        int dr = (rgbMatV[0]*v + (1 << (RGB_FIX_SHIFT-1))) >> RGB_FIX_SHIFT;
+        int dg = (rgbMatU[0]*u + rgbMatV[1]*v + (1 << (RGB_FIX_SHIFT-1))) >> RGB_FIX_SHIFT;
+        int db = (rgbMatU[1]*u + (1 << (RGB_FIX_SHIFT-1))) >> RGB_FIX_SHIFT;
+        for (int i = 0; i < 2; i++)
+        {
+            unsigned char* pixel = oDst + 4*(x+i);
+            int y = iY[x+i];
+            pixel[iRGBOffsets[0]] = clampByte(y + dr);
+            pixel[iRGBOffsets[1]] = clampByte(y + dg);
+            pixel[iRGBOffsets[2]] = clampByte(y + db);
+            pixel[iRGBOffsets[3]] = 0xFF;
         }
     }
+}
 
-    sceKernelFreeMemBlock(bufferID);
-    return 1;
+static void VideoToRGBA(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers, const int iRGBOffsets[4])
+{
+    const unsigned char* srcU = iSrc + iWidth*iHeight;
+    const unsigned char* srcV = srcU + (iWidth/2)*(iHeight/2);
+    for (int row = 0; row < iHeight; row++)
+        VideoRowToRGBA(iSrc + row*iWidth, srcU + (row/2)*(iWidth/2), srcV + (row/2)*(iWidth/2),
+                       (unsigned char*)oBuffers->blocksData[0] + row*oBuffers->rowStride[0], iWidth, iRGBOffsets);
 }
 
-static int LoadBMPFile(SceUID iFile, SceCameraFormat iFormat, char* iMemName, ImageBuffers* oBuffers)
+static void VideoToABGR(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers)
 {
-    BITMAPFILEHEADER bmp_fh;
-#ifdef READ_WITH_KUIO
-    kuIoRead(iFile, (void *)&bmp_fh, sizeof(BITMAPFILEHEADER));
-#else
-    sceIoRead(iFile, (void *)&bmp_fh, sizeof(BITMAPFILEHEADER));
-#endif
-    if (bmp_fh.bfType != BMP_SIGNATURE)
-        return -1;
+    static const int offsets[4] = { 0, 1, 2, 3 };
+    VideoToRGBA(iSrc, iWidth, iHeight, oBuffers, offsets);
+}
 
-    BITMAPINFOHEADER bmp_ih;
-#ifdef READ_WITH_KUIO
-    kuIoRead(iFile, (void *)&bmp_ih, sizeof(BITMAPINFOHEADER));
-#else
-    sceIoRead(iFile, (void *)&bmp_ih, sizeof(BITMAPINFOHEADER));
-#endif
+static void VideoToARGB(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers)
+{
+    static const int offsets[4] = { 2, 1, 0, 3 };
+    VideoToRGBA(iSrc, iWidth, iHeight, oBuffers, offsets);
+}
 
-    BufferWriteFunc writeFunc = NULL;
-    char funcData[24];
-    
-    oBuffers->imageWidth = bmp_ih.biWidth;
-    oBuffers->imageHeight = bmp_ih.biHeight;
-    oBuffers->rowStride[0] = 0;
-    oBuffers->rowStride[1] = 0;
-    oBuffers->rowStride[2] = 0;
-    oBuffers->rowDepend[0] = 1;
-    oBuffers->rowDepend[1] = 1;
-    oBuffers->rowDepend[2] = 1;
-    oBuffers->widthAlign = 1;
-    oBuffers->heightAlign = 1;
-
-    switch (iFormat)
-    {
-    case SCE_CAMERA_FORMAT_ARGB:
-        oBuffers->texelBits[0] = 32;
-        writeFunc = &ARGBWrite;
-        break;
-    case SCE_CAMERA_FORMAT_ABGR:
-        oBuffers->texelBits[0] = 32;
-        writeFunc = &ABGRWrite;
-        break;
-    case SCE_CAMERA_FORMAT_YUV422_PACKED:
-        oBuffers->texelBits[0] = 16;
-        oBuffers->widthAlign = 2;
-        writeFunc = &YUV422PackedWrite;
-        break;
-    case SCE_CAMERA_FORMAT_YUV422_PLANE:
-        oBuffers->texelBits[0] = 8;
-        oBuffers->texelBits[1] = 4;
-        oBuffers->texelBits[2] = 4;
-        oBuffers->widthAlign = 2;
-        writeFunc = &YUV422PlaneWrite;
-        break;
-    case SCE_CAMERA_FORMAT_YUV420_PLANE:
-        oBuffers->texelBits[0] = 8;
-        oBuffers->texelBits[1] = 2;
-        oBuffers->rowDepend[1] = 2;
-        oBuffers->texelBits[2] = 2;
-        oBuffers->rowDepend[2] = 2;
-        oBuffers->widthAlign = 2;
-        oBuffers->heightAlign = 2;
-        writeFunc = &YUV420PlaneWrite;
-        break;
-    case SCE_CAMERA_FORMAT_RAW8:
-    case SCE_CAMERA_FORMAT_INVALID:
-        return -1;
+static void VideoToRAW8(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers)
+{
+    const unsigned char* srcU = iSrc + iWidth*iHeight;
+    const unsigned char* srcV = srcU + (iWidth/2)*(iHeight/2);
+    for (int row = 0; row < iHeight; row++)
+    {
+        const unsigned char* channels = bayerChannels[config.bayerPattern][row&1];
+        const unsigned char* y = iSrc + row*iWidth;
+        const unsigned char* u = srcU + (row/2)*(iWidth/2);
+        const unsigned char* v = srcV + (row/2)*(iWidth/2);
+        unsigned char* dst = (unsigned char*)oBuffers->blocksData[0] + row*oBuffers->rowStride[0];
+        for (int x = 0; x < iWidth; x += 2)
+        {
+            int du = u[x/2] - 128;
+            int dv = v[x/2] - 128;
+            int delta[3] = { (rgbMatU[1]*du + (1 << (RGB_FIX_SHIFT-1))) >> RGB_FIX_SHIFT,
+                             (rgbMatU[0]*du + rgbMatV[1]*dv + (1 << (RGB_FIX_SHIFT-1))) >> RGB_FIX_SHIFT,
+                             (rgbMatV[0]*dv + (1 << (RGB_FIX_SHIFT-1))) >> RGB_FIX_SHIFT };
+            dst[x] = clampByte(y[x] + delta[channels[0]]);
+            dst[x+1] = clampByte(y[x+1] + delta[channels[1]]);
+        }
     }
-    
-    if (NULL == writeFunc)
-        return -1;
-
-    oBuffers->imageWidth = (bmp_ih.biWidth/oBuffers->widthAlign)*oBuffers->widthAlign;
-    oBuffers->imageHeight = (bmp_ih.biHeight/oBuffers->heightAlign)*oBuffers->heightAlign;
+}
 
-    char memname[48];
-    for (int i = 0; i < 3; i++)
+static void VideoToYUV422Packed(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers)
+{
+    const unsigned char* srcU = iSrc + iWidth*iHeight;
+    const unsigned char* srcV = srcU + (iWidth/2)*(iHeight/2);
+    for (int row = 0; row < iHeight; row++)
     {
-        oBuffers->rowStride[i] = (oBuffers->imageWidth*oBuffers->texelBits[i]*oBuffers->rowDepend[i])/8;
-        if (oBuffers->rowStride[i] > 0)
+        const unsigned char* y = iSrc + row*iWidth;
+        const unsigned char* u = srcU + (row/2)*(iWidth/2);
+        const unsigned char* v = srcV + (row/2)*(iWidth/2);
+        unsigned char* dst = (unsigned char*)oBuffers->blocksData[0] + row*oBuffers->rowStride[0];
+        for (int x = 0; x < iWidth/2; x++)
         {
-            sprintf(memname, "%s_%d", iMemName, i);
-            unsigned int size = alignSizeForMemBlock(oBuffers->rowStride[i]*oBuffers->imageHeight/oBuffers->rowDepend[i]);
-            oBuffers->blockIDs[i] = sceKernelAllocMemBlock(memname, SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, size, NULL);
-            oBuffers->blocksData[i] = NULL;
-            sceKernelGetMemBlockBase(oBuffers->blockIDs[i], (void **)&oBuffers->blocksData[i]);
-
-            if (!oBuffers->blocksData[i])
-            {
-                sceKernelFreeMemBlock(oBuffers->blockIDs[i]);
-                oBuffers->blockIDs[i] = -1;
-                return -1;
-            }
+            dst[4*x] = u[x];
+            dst[4*x+1] = y[2*x];
+            dst[4*x+2] = v[x];
+            dst[4*x+3] = y[2*x+1];
         }
     }
-    
-    return LoadBMPGeneric(&bmp_fh, &bmp_ih, iFile, oBuffers, writeFunc, funcData);
 }
 
-//#define bitSize(size, bits) ((size*bits)/8)
-unsigned int bitSize(unsigned int size, unsigned int bits)
+static void VideoToYUV422Plane(const unsigned char* iSrc, unsigned int iWidth, unsigned int iHeight, const ImageBuffers* oBuffers)
 {
-    return (size*bits) / 8;
+    const unsigned char* srcU = iSrc + iWidth*iHeight;
+    const unsigned char* srcV = srcU + (iWidth/2)*(iHeight/2);
+    memcpy(oBuffers->blocksData[0], iSrc, iWidth*iHeight);
+    for (int row = 0; row < iHeight; row++)
+    {
+        memcpy((unsigned char*)oBuffers->blocksData[1] + row*oBuffers->rowStride[1], srcU + (row/2)*(iWidth/2), iWidth/2);
+        memcpy((unsigned char*)oBuffers->blocksData[2] + row*oBuffers->rowStride[2], srcV + (row/2)*(iWidth/2), iWidth/2);
+    }
 }
 
-// Math functions (used by motion detection)
+// Camera formats support
+// A row converter gets iRows consecutive BMP rows (bottom-up order) and writes them in each plane starting at oDst[i],
+// iDstStride[i] being the offset between two consecutive plane rows (negative as BMP rows are stored upside down)
+
+typedef void (*RowConvertFunc)(const unsigned char* iSrc, unsigned int iSrcStride,
+                               unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows);
+
+// Defines the row converters of every camera format for BMP pixels of the given bit depth
+#define DEFINE_ROW_CONVERTERS(bits) \
+static void ABGRConvert##bits(const unsigned char* iSrc, unsigned int iSrcStride, \
+                              unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows) \
+{ \
+    for (int row = 0; row < iRows; row++) \
+        RowToABGR(iSrc + row*iSrcStride, bits, oDst[0] + row*iDstStride[0], iWidth); \
+} \
+static void ARGBConvert##bits(const unsigned char* iSrc, unsigned int iSrcStride, \
+                              unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows) \
+{ \
+    for (int row = 0; row < iRows; row++) \
+        RowToARGB(iSrc + row*iSrcStride, bits, oDst[0] + row*iDstStride[0], iWidth); \
+} \
+static void YUV422PackedConvert##bits(const unsigned char* iSrc, unsigned int iSrcStride, \
+                                      unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows) \
+{ \
+    for (int row = 0; row < iRows; row++) \
+        RowToYUV422Packed(iSrc + row*iSrcStride, bits, oDst[0] + row*iDstStride[0], iWidth); \
+} \
+static void YUV422PlaneConvert##bits(const unsigned char* iSrc, unsigned int iSrcStride, \
+                                     unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows) \
+{ \
+    for (int row = 0; row < iRows; row++) \
+        RowToYUV422Plane(iSrc + row*iSrcStride, bits, oDst[0] + row*iDstStride[0], \
+                         oDst[1] + row*iDstStride[1], oDst[2] + row*iDstStride[2], iWidth); \
+} \
+static void YUV420PlaneConvert##bits(const unsigned char* iSrc, unsigned int iSrcStride, \
+                                     unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows) \
+{ \
+    for (int row = 0; row < iRows; row += 2) \
+        RowPairToYUV420Plane(iSrc + row*iSrcStride, iSrc + (row+1)*iSrcStride, bits, \
+                             oDst[0] + row*iDstStride[0], oDst[0] + (row+1)*iDstStride[0], \
+                             oDst[1] + (row/2)*iDstStride[1], oDst[2] + (row/2)*iDstStride[2], iWidth); \
+} \
+static void RAW8Convert##bits(const unsigned char* iSrc, unsigned int iSrcStride, \
+                              unsigned char* oDst[3], const int iDstStride[3], unsigned int iWidth, unsigned int iRows) \
+{ \
+    /* Row pairs start at an even row from the image bottom, which is an odd image row (even image height) */ \
+    const unsigned char (*channels)[2] = bayerChannels[config.bayerPattern]; \
+    for (int row = 0; row < iRows; row += 2) \
+    { \
+        RowToRAW8(iSrc + row*iSrcStride, bits, oDst[0] + row*iDstStride[0], iWidth, channels[1]); \
+        RowToRAW8(iSrc + (row+1)*iSrcStride, bits, oDst[0] + (row+1)*iDstStride[0], iWidth, channels[0]); \
+    } \
+}
 
-#define abs(val) ((val < 0) ? -val : val)
-#define sign(val) ((val > 0) ? 1 : ((val < 0) ? -1 : 0))
-#define clamp(val, min, max) ((val > max) ? max : ((val < min) ? min : val))
+DEFINE_ROW_CONVERTERS(16)
+DEFINE_ROW_CONVERTERS(24)
+DEFINE_ROW_CONVERTERS(32)
 
-#define M_PI 3.14159265359f
+#define ROW_CONVERTERS(name) { &name##16, &name##24, &name##32 }
 
-float atan2_approx(float y, float x)
+typedef struct {
+    SceCameraFormat format;
+    uint16_t texelBits[3];
+    uint16_t rowDepend[3];
+    uint16_t widthAlign;
+    uint16_t heightAlign;
+    RowConvertFunc convert[3];     // For 16, 24 and 32 bits BMP pixels
+    unsigned int black[3];         // 32 bits pattern of a black area in each plane
+    VideoConvertFunc convertVideo; // NULL when video frames are read straight into the planes
+} CameraFormatDesc;
+
+static const CameraFormatDesc cameraFormats[] = {
+    { SCE_CAMERA_FORMAT_ARGB,          {32, 0, 0}, {1, 1, 1}, 1, 1, ROW_CONVERTERS(ARGBConvert),         {0xFF000000, 0, 0},          &VideoToARGB },
+    { SCE_CAMERA_FORMAT_ABGR,          {32, 0, 0}, {1, 1, 1}, 1, 1, ROW_CONVERTERS(ABGRConvert),         {0xFF000000, 0, 0},          &VideoToABGR },
+    { SCE_CAMERA_FORMAT_YUV422_PACKED, {16, 0, 0}, {1, 1, 1}, 2, 1, ROW_CONVERTERS(YUV422PackedConvert), {0x00800080, 0, 0},          &VideoToYUV422Packed },
+    { SCE_CAMERA_FORMAT_YUV422_PLANE,  {8, 4, 4},  {1, 1, 1}, 2, 1, ROW_CONVERTERS(YUV422PlaneConvert),  {0, 0x80808080, 0x80808080}, &VideoToYUV422Plane },
+    { SCE_CAMERA_FORMAT_YUV420_PLANE,  {8, 2, 2},  {1, 2, 2}, 2, 2, ROW_CONVERTERS(YUV420PlaneConvert),  {0, 0x80808080, 0x80808080}, NULL },
+    { SCE_CAMERA_FORMAT_RAW8,          {8, 0, 0},  {1, 1, 1}, 2, 2, ROW_CONVERTERS(RAW8Convert),         {0, 0, 0},                   &VideoToRAW8 },
+};
+
+static const CameraFormatDesc* FindCameraFormat(SceCameraFormat iFormat)
 {
-    static float ONEQTR_PI = M_PI / 4.0;
-	static float THRQTR_PI = 3.0 * M_PI / 4.0;
-	float r, angle;
-	float abs_y = abs(y) + 1e-10f;
-	if ( x < 0.0f )
-	{
-		r = (x + abs_y) / (abs_y - x);
-		angle = THRQTR_PI;
-	}
-	else
-	{
-		r = (x - abs_y) / (x + abs_y);
-		angle = ONEQTR_PI;
-	}
-	angle += (0.1963f * r * r - 0.9817f) * r;
-	if ( y < 0.0f )
-		return -angle;
-
-    return angle;
+    for (int i = 0; i < sizeof(cameraFormats)/sizeof(cameraFormats[0]); i++)
+    {
+        if (cameraFormats[i].format == iFormat)
+            return &cameraFormats[i];
+    }
+    return NULL;
 }
 
-static char titleid[16] = {'\0'};
-
-#endif
+// Samples of each image component in camera formats planes (same order as cameraFormats), used for resampling
+typedef struct {
+    uint8_t plane;
+    uint8_t offset;    // Byte offset of the first sample in a plane row
+    uint8_t step;      // Bytes between two horizontal samples
+    uint8_t subWidth;  // Horizontal subsampling
+    uint8_t subHeight; // Vertical subsampling
+    uint8_t row;       // Plane row of the first samples
+    uint8_t rowStep;   // Plane rows between two rows of samples (1 when plane rows are already subsampled)
+} ImageComponent;
+
+#define MAX_IMAGE_COMPONENTS 4
+
+static const ImageComponent cameraFormatComponents[][MAX_IMAGE_COMPONENTS] = {
+    { {0, 0, 4, 1, 1, 0, 1}, {0, 1, 4, 1, 1, 0, 1}, {0, 2, 4, 1, 1, 0, 1}, {0, 3, 4, 1, 1, 0, 1} }, // ARGB
+    { {0, 0, 4, 1, 1, 0, 1}, {0, 1, 4, 1, 1, 0, 1}, {0, 2, 4, 1, 1, 0, 1}, {0, 3, 4, 1, 1, 0, 1} }, // ABGR
+    { {0, 1, 2, 1, 1, 0, 1}, {0, 0, 4, 2, 1, 0, 1}, {0, 2, 4, 2, 1, 0, 1}, {0, 0, 0, 0, 0, 0, 0} }, // YUV422 packed (U Y0 V Y1)
+    { {0, 0, 1, 1, 1, 0, 1}, {1, 0, 1, 2, 1, 0, 1}, {2, 0, 1, 2, 1, 0, 1}, {0, 0, 0, 0, 0, 0, 0} }, // YUV422 planes
+    { {0, 0, 1, 1, 1, 0, 1}, {1, 0, 1, 2, 2, 0, 1}, {2, 0, 1, 2, 2, 0, 1}, {0, 0, 0, 0, 0, 0, 0} }, // YUV420 planes
+    { {0, 0, 2, 2, 2, 0, 2}, {0, 1, 2, 2, 2, 0, 2}, {0, 0, 2, 2, 2, 1, 2}, {0, 1, 2, 2, 2, 1, 2} }, // RAW8 (each site of 2x2 blocks)
+};
+
+// Fills iSize bytes of a plane with a 32 bits pattern (iSize is a multiple of 4)
+static void FillPattern(void* oDst, unsigned int iPattern, unsigned int iSize)
+{
+    if ((iPattern&0xFF)*0x01010101 == iPattern)
+    {
+        memset(oDst, iPattern&0xFF, iSize);
+        return;
+    }
+    unsigned int* dst = (unsigned int*)oDst;
+    for (int i = 0; i < iSize/4; i++)
+        dst[i] = iPattern;
+}
 
+// Memory arena
+// BMP pixels, image planes and video staging are carved out of a single memory block allocated on first use, instead
+// of a memory block each (rounded up to 4 KB pages); allocations which don't fit get their own memory block
 
-static SceUID g_hooks[39];
+#define MAX_ARENA_ALLOCS 64
+#define ARENA_ALIGN      64
 
-// Open - Close
+typedef struct {
+    SceUID blockID;
+    unsigned char* base;
+    unsigned int size;
+    int failed;                              // The memory block couldn't be allocated
+    unsigned int count;
+    unsigned int offsets[MAX_ARENA_ALLOCS]; // Allocations sorted by offset
+    unsigned int sizes[MAX_ARENA_ALLOCS];
+    unsigned int used;
+    unsigned int peak;                       // High-water mark of used bytes
+    unsigned int fallbacks;                  // Allocations which got their own memory block
+} MemoryArena;
+
+static MemoryArena arena = { -1, NULL, 0, 0, 0, {0}, {0}, 0, 0, 0 };
+static SceUID arenaMutex = -1;
+
+static inline unsigned int ArenaAllocSize(unsigned int iSize)
+{
+    return (iSize + ARENA_ALIGN-1) & ~(ARENA_ALIGN-1);
+}
 
-#define NB_CAM 2
+// Must be called with arenaMutex locked, first fit
+static void* ArenaAlloc(unsigned int iSize)
+{
+    if (arena.blockID < 0 && !arena.failed)
+    {
+        arena.size = alignSizeForMemBlock((unsigned int)config.memoryArena*1024);
+        arena.blockID = sceKernelAllocMemBlock("fakecamera_arena", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, arena.size, NULL);
+        arena.base = NULL;
+        if (arena.blockID >= 0)
+            sceKernelGetMemBlockBase(arena.blockID, (void **)&arena.base);
+        if (NULL == arena.base)
+        {
+            if (arena.blockID >= 0)
+                sceKernelFreeMemBlock(arena.blockID);
+            arena.blockID = -1;
+            arena.failed = 1;
+        }
+    }
+    if (NULL == arena.base || arena.count == MAX_ARENA_ALLOCS)
+        return NULL;
+
+    unsigned int size = ArenaAllocSize(iSize);
+    unsigned int offset = 0;
+    unsigned int i = 0;
+    for (; i < arena.count && arena.offsets[i] - offset < size; i++)
+        offset = arena.offsets[i] + arena.sizes[i];
+    if (i == arena.count && arena.size - offset < size)
+        return NULL;
+
+    for (unsigned int j = arena.count; j > i; j--)
+    {
+        arena.offsets[j] = arena.offsets[j-1];
+        arena.sizes[j] = arena.sizes[j-1];
+    }
+    arena.offsets[i] = offset;
+    arena.sizes[i] = size;
+    arena.count++;
+    arena.used += size;
+    if (arena.used > arena.peak)
+        arena.peak = arena.used;
+    return arena.base + offset;
+}
+
+// Must be called with arenaMutex locked
+static void ArenaFree(void* iData)
+{
+    unsigned int offset = (unsigned char*)iData - arena.base;
+    for (unsigned int i = 0; i < arena.count; i++)
+    {
+        if (arena.offsets[i] == offset)
+        {
+            arena.used -= arena.sizes[i];
+            arena.count--;
+            for (; i < arena.count; i++)
+            {
+                arena.offsets[i] = arena.offsets[i+1];
+                arena.sizes[i] = arena.sizes[i+1];
+            }
+            return;
+        }
+    }
+}
+
+// Returns iSize bytes (NULL on failure), *oBlockID is the arena memory block or a memory block named iName
+static void* AllocMemory(const char* iName, unsigned int iSize, SceUID* oBlockID)
+{
+    void* data = NULL;
+    if (config.memoryArena > 0 && arenaMutex >= 0)
+    {
+        sceKernelLockMutex(arenaMutex, 1, NULL);
+        data = ArenaAlloc(iSize);
+        if (NULL == data)
+            arena.fallbacks++;
+        sceKernelUnlockMutex(arenaMutex, 1);
+        if (NULL != data)
+        {
+            *oBlockID = arena.blockID;
+            return data;
+        }
+    }
+
+    *oBlockID = sceKernelAllocMemBlock(iName, SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, alignSizeForMemBlock(iSize), NULL);
+    if (*oBlockID >= 0)
+        sceKernelGetMemBlockBase(*oBlockID, &data);
+    if (NULL == data && *oBlockID >= 0)
+    {
+        sceKernelFreeMemBlock(*oBlockID);
+        *oBlockID = -1;
+    }
+    return data;
+}
+
+static void FreeMemory(SceUID iBlockID, void* iData)
+{
+    if (iBlockID < 0)
+        return;
+    if (iBlockID != arena.blockID)
+    {
+        sceKernelFreeMemBlock(iBlockID);
+        return;
+    }
+    sceKernelLockMutex(arenaMutex, 1, NULL);
+    ArenaFree(iData);
+    sceKernelUnlockMutex(arenaMutex, 1);
+}
+
+// Memory really used by an allocation of iSize bytes
+static unsigned int MemorySize(SceUID iBlockID, unsigned int iSize)
+{
+    return (iBlockID >= 0 && iBlockID == arena.blockID) ? ArenaAllocSize(iSize) : alignSizeForMemBlock(iSize);
+}
+
+// Bitmap reading functions
+
+typedef struct {
+    unsigned int ioWaitTime;  // Microseconds spent waiting for file data
+    unsigned int computeTime; // Microseconds spent converting pixels
+} LoadStats;
+
+// BMP pixels (rows stored bottom-up as in the file) kept in memory to convert the image to other formats without reading it again
+typedef struct {
+    SceUID blockID;
+    unsigned char* data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int bits;
+    unsigned int rowStride;
+} BitmapPixels;
+
+#define BITMAP_PIXELS_INIT { -1, NULL, 0, 0, 0, 0 }
+
+static void FreeBitmapPixels(BitmapPixels* ioPixels)
+{
+    FreeMemory(ioPixels->blockID, ioPixels->data);
+    ioPixels->blockID = -1;
+    ioPixels->data = NULL;
+}
+
+// Overlapped BMP reading: a helper thread reads chunks of rows in the pixels block while the previous chunks are converted
+typedef struct {
+    SceUID file;
+    unsigned char* data;
+    unsigned int rowStride;
+    unsigned int chunkRows;
+    unsigned int rowCount;
+    SceUID readySema; // Chunks filled with file data
+    volatile int failed; // Set before the last signal when a chunk couldn't be read whole
+} ReadPipeline;
+
+static inline unsigned int ChunkRows(ReadPipeline* iPipe, unsigned int iRow)
+{
+    return (iPipe->rowCount - iRow < iPipe->chunkRows) ? iPipe->rowCount - iRow : iPipe->chunkRows;
+}
+
+static int ReadPipelineThread(SceSize args, void *argp)
+{
+    ReadPipeline* pipe = *(ReadPipeline**)argp;
+    for (unsigned int y = 0; y < pipe->rowCount; y += pipe->chunkRows)
+    {
+        unsigned int size = ChunkRows(pipe, y)*pipe->rowStride;
+        if (ReadFile(pipe->file, pipe->data + y*pipe->rowStride, size) != size)
+            pipe->failed = 1;
+        sceKernelSignalSema(pipe->readySema, 1);
+        if (pipe->failed)
+            break;
+    }
+    return 0;
+}
+
+// Converts iRows BMP rows from iSrc, which holds row iY (counted from the image bottom) and the next ones
+static void ConvertBitmapRows(const unsigned char* iSrc, unsigned int iSrcStride, unsigned int iY, unsigned int iRows, ImageBuffers* oBuffers, RowConvertFunc iConvert)
+{
+    unsigned char* dst[3];
+    int dstStride[3];
+    for (int i = 0; i < 3; i++)
+    {
+        dst[i] = (unsigned char*)oBuffers->blocksData[i] + ((oBuffers->imageHeight-1-iY)/oBuffers->rowDepend[i])*oBuffers->rowStride[i];
+        dstStride[i] = -(int)oBuffers->rowStride[i];
+    }
+
+    iConvert(iSrc, iSrcStride, dst, dstStride, oBuffers->imageWidth, iRows);
+}
+
+// Rows above the aligned image height are only kept for formats with a smaller alignment
+static inline unsigned int ConvertedRows(const ImageBuffers* iBuffers, unsigned int iY, unsigned int iRows)
+{
+    if (iY >= iBuffers->imageHeight)
+        return 0;
+    return (iBuffers->imageHeight - iY < iRows) ? iBuffers->imageHeight - iY : iRows;
+}
+
+// BMP pixels streamed through a single chunk of rows, which are not kept: reading doesn't overlap conversion and
+// another camera format has to read the BMP file again
+static int LoadBMPStreamed(BITMAPFILEHEADER *bmp_fh, const BitmapPixels* iPixels, SceUID iFile, ImageBuffers* oBuffers, RowConvertFunc iConvert, LoadStats* oStats)
+{
+    unsigned int chunkRows = (iPixels->height < config.loadChunkRows) ? iPixels->height : config.loadChunkRows;
+    SceUID chunkID;
+    unsigned char* chunk = AllocMemory("bitmap_chunk", chunkRows*iPixels->rowStride, &chunkID);
+    if (!chunk)
+        return -1;
+
+    SeekFile(iFile, bmp_fh->bfOffBits);
+    oStats->ioWaitTime = 0;
+    oStats->computeTime = 0;
+
+    int res = 1;
+    for (unsigned int y = 0; y < iPixels->height && y < oBuffers->imageHeight; y += chunkRows)
+    {
+        unsigned int rows = (iPixels->height - y < chunkRows) ? iPixels->height - y : chunkRows;
+
+        uint64_t waitTime = sceKernelGetProcessTimeWide();
+        if (ReadFile(iFile, chunk, rows*iPixels->rowStride) != rows*iPixels->rowStride)
+        {
+            res = -1;
+            break;
+        }
+
+        uint64_t computeTime = sceKernelGetProcessTimeWide();
+        oStats->ioWaitTime += computeTime - waitTime;
+        ConvertBitmapRows(chunk, iPixels->rowStride, y, ConvertedRows(oBuffers, y, rows), oBuffers, iConvert);
+        oStats->computeTime += sceKernelGetProcessTimeWide() - computeTime;
+    }
+
+    FreeMemory(chunkID, chunk);
+    return res;
+}
+
+static int LoadBMPGeneric(BITMAPFILEHEADER *bmp_fh, BITMAPINFOHEADER *bmp_ih, SceUID iFile,
+                          BitmapPixels* oPixels, ImageBuffers* oBuffers, RowConvertFunc iConvert, LoadStats* oStats)
+{    
+    oPixels->width = bmp_ih->biWidth;
+    oPixels->height = bmp_ih->biHeight;
+    oPixels->bits = bmp_ih->biBitCount;
+    oPixels->rowStride = oPixels->width * (oPixels->bits/8);
+    if (oPixels->rowStride%4 != 0) {
+        oPixels->rowStride += 4-(oPixels->rowStride%4);
+    }
+
+    // BMP pixels are kept for other camera formats when they fit in "imageMemoryLimit" and can be allocated
+    if (oPixels->rowStride*oPixels->height <= (unsigned int)config.imageMemoryLimit*1024)
+        oPixels->data = AllocMemory("bitmap_block", oPixels->rowStride*oPixels->height, &oPixels->blockID);
+    if (!oPixels->data)
+    {
+        oPixels->blockID = -1;
+        return LoadBMPStreamed(bmp_fh, oPixels, iFile, oBuffers, iConvert, oStats);
+    }
+
+    ReadPipeline pipe;
+    pipe.file = iFile;
+    pipe.data = oPixels->data;
+    pipe.rowStride = oPixels->rowStride;
+    pipe.chunkRows = config.loadChunkRows;
+    pipe.rowCount = oPixels->height;
+    pipe.failed = 0;
+
+    SeekFile(iFile, bmp_fh->bfOffBits);
+
+    // Without reading thread, chunks are read synchronously
+    ReadPipeline* pipePtr = &pipe;
+    SceUID threadID = -1;
+    pipe.readySema = sceKernelCreateSema("fakecamera_ready", 0, 0, (pipe.rowCount+pipe.chunkRows-1)/pipe.chunkRows, NULL);
+    if (pipe.readySema >= 0)
+        threadID = sceKernelCreateThread("fakecamera_reader", &ReadPipelineThread, 0x10000100, 0x2000, 0, 0, NULL);
+    int async = (threadID >= 0 && sceKernelStartThread(threadID, sizeof(pipePtr), &pipePtr) >= 0);
+
+    oStats->ioWaitTime = 0;
+    oStats->computeTime = 0;
+
+    for (unsigned int y = 0; y < pipe.rowCount; y += pipe.chunkRows)
+    {
+        unsigned int rows = ChunkRows(&pipe, y);
+
+        uint64_t waitTime = sceKernelGetProcessTimeWide();
+        if (async)
+            sceKernelWaitSema(pipe.readySema, 1, NULL);
+        else if (ReadFile(iFile, pipe.data + y*pipe.rowStride, rows*pipe.rowStride) != rows*pipe.rowStride)
+            pipe.failed = 1;
+        if (pipe.failed)
+            break;
+
+        uint64_t computeTime = sceKernelGetProcessTimeWide();
+        oStats->ioWaitTime += computeTime - waitTime;
+
+        if (y < oBuffers->imageHeight)
+            ConvertBitmapRows(oPixels->data + y*oPixels->rowStride, oPixels->rowStride, y, ConvertedRows(oBuffers, y, rows), oBuffers, iConvert);
+        oStats->computeTime += sceKernelGetProcessTimeWide() - computeTime;
+    }
+
+    if (threadID >= 0)
+    {
+        if (async)
+            sceKernelWaitThreadEnd(threadID, NULL, NULL);
+        sceKernelDeleteThread(threadID);
+    }
+    if (pipe.readySema >= 0)
+        sceKernelDeleteSema(pipe.readySema);
+
+    // Truncated file: pixels are not kept
+    if (pipe.failed)
+    {
+        FreeBitmapPixels(oPixels);
+        return -1;
+    }
+    return 1;
+}
+
+// Exchanges two rows of 32 bits pixels (iRow1 may be iRow2), swapping red and blue bytes when iSwapRB is set
+static void SwapPixelRows(unsigned char* ioRow1, unsigned char* ioRow2, unsigned int iWidth, int iSwapRB)
+{
+    unsigned int x = 0;
+#ifdef __ARM_NEON
+    for (; x+16 <= iWidth; x += 16)
+    {
+        uint8x16x4_t pix1 = vld4q_u8(ioRow1+x*4);
+        uint8x16x4_t pix2 = vld4q_u8(ioRow2+x*4);
+        if (iSwapRB)
+        {
+            uint8x16_t blue = pix1.val[0];
+            pix1.val[0] = pix1.val[2];
+            pix1.val[2] = blue;
+            blue = pix2.val[0];
+            pix2.val[0] = pix2.val[2];
+            pix2.val[2] = blue;
+        }
+        vst4q_u8(ioRow1+x*4, pix2);
+        vst4q_u8(ioRow2+x*4, pix1);
+    }
+#endif
+    uint32_t* row1 = (uint32_t*)ioRow1;
+    uint32_t* row2 = (uint32_t*)ioRow2;
+    for (; x < iWidth; x++)
+    {
+        uint32_t pix1 = row1[x];
+        uint32_t pix2 = row2[x];
+        if (iSwapRB)
+        {
+            pix1 = (pix1 & 0xFF00FF00) | ((pix1>>16) & 0xFF) | ((pix1 & 0xFF)<<16);
+            pix2 = (pix2 & 0xFF00FF00) | ((pix2>>16) & 0xFF) | ((pix2 & 0xFF)<<16);
+        }
+        row1[x] = pix2;
+        row2[x] = pix1;
+    }
+}
+
+// 32 bits BMP opened as ARGB (same byte order) or ABGR: chunks of rows are read straight into their final place in the
+// plane, then their order is reversed in place (with red and blue swapped for ABGR); BMP pixels are not kept in memory
+static int LoadBMPDirect(BITMAPFILEHEADER *bmp_fh, SceUID iFile, ImageBuffers* oBuffers, int iSwapRB, LoadStats* oStats)
+{
+    unsigned int rowSize = oBuffers->rowStride[0];
+    unsigned int height = oBuffers->imageHeight;
+    unsigned char* plane = (unsigned char*)oBuffers->blocksData[0];
+
+    SeekFile(iFile, bmp_fh->bfOffBits);
+    oStats->ioWaitTime = 0;
+    oStats->computeTime = 0;
+
+    for (unsigned int y = 0; y < height; y += config.loadChunkRows)
+    {
+        unsigned int rows = (height - y < config.loadChunkRows) ? height - y : config.loadChunkRows;
+        unsigned char* chunk = plane + (height-y-rows)*rowSize;
+
+        uint64_t waitTime = sceKernelGetProcessTimeWide();
+        if (ReadFile(iFile, chunk, rows*rowSize) != rows*rowSize)
+            return -1;
+
+        uint64_t computeTime = sceKernelGetProcessTimeWide();
+        oStats->ioWaitTime += computeTime - waitTime;
+        if (iSwapRB || rows > 1)
+        {
+            for (unsigned int top = 0, bottom = rows-1; top <= bottom && bottom < rows; top++, bottom--)
+                SwapPixelRows(chunk + top*rowSize, chunk + bottom*rowSize, oBuffers->imageWidth, iSwapRB);
+        }
+        oStats->computeTime += sceKernelGetProcessTimeWide() - computeTime;
+    }
+    return 1;
+}
+
+static void SetImageGeometry(const CameraFormatDesc* iDesc, unsigned int iWidth, unsigned int iHeight, ImageBuffers* oBuffers)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        oBuffers->texelBits[i] = iDesc->texelBits[i];
+        oBuffers->rowDepend[i] = iDesc->rowDepend[i];
+    }
+    oBuffers->widthAlign = iDesc->widthAlign;
+    oBuffers->heightAlign = iDesc->heightAlign;
+
+    oBuffers->imageWidth = (iWidth/oBuffers->widthAlign)*oBuffers->widthAlign;
+    oBuffers->imageHeight = (iHeight/oBuffers->heightAlign)*oBuffers->heightAlign;
+
+    for (int i = 0; i < 3; i++)
+        oBuffers->rowStride[i] = (oBuffers->imageWidth*oBuffers->texelBits[i]*oBuffers->rowDepend[i])/8;
+}
+
+// Image planes allocation once oBuffers geometry is set
+static int AllocImageBuffers(const char* iMemName, ImageBuffers* oBuffers)
+{
+    char memname[72];
+    for (int i = 0; i < 3; i++)
+    {
+        oBuffers->blocksData[i] = NULL;
+        if (oBuffers->rowStride[i] > 0)
+        {
+            snprintf(memname, sizeof(memname), "%s_%d", iMemName, i);
+            oBuffers->blocksData[i] = AllocMemory(memname, oBuffers->rowStride[i]*oBuffers->imageHeight/oBuffers->rowDepend[i], &oBuffers->blockIDs[i]);
+            if (!oBuffers->blocksData[i])
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static void FreeImageBuffers(ImageBuffers* ioBuffers)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        FreeMemory(ioBuffers->blockIDs[i], ioBuffers->blocksData[i]);
+        ioBuffers->blockIDs[i] = -1;
+        ioBuffers->blocksData[i] = NULL;
+    }
+}
+
+static unsigned int ImageBuffersSize(const ImageBuffers* iBuffers)
+{
+    unsigned int size = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (iBuffers->blockIDs[i] >= 0)
+            size += MemorySize(iBuffers->blockIDs[i], iBuffers->rowStride[i]*iBuffers->imageHeight/iBuffers->rowDepend[i]);
+    }
+    return size;
+}
+
+// Converts BMP pixels already in memory to another camera format
+static int ConvertBitmap(const BitmapPixels* iPixels, SceCameraFormat iFormat, const char* iMemName, ImageBuffers* oBuffers, LoadStats* oStats)
+{
+    const CameraFormatDesc* desc = FindCameraFormat(iFormat);
+    if (NULL == desc)
+        return -1;
+
+    SetImageGeometry(desc, iPixels->width, iPixels->height, oBuffers);
+    if (AllocImageBuffers(iMemName, oBuffers) < 0)
+        return -1;
+
+    uint64_t computeTime = sceKernelGetProcessTimeWide();
+    ConvertBitmapRows(iPixels->data, iPixels->rowStride, 0, oBuffers->imageHeight, oBuffers, desc->convert[iPixels->bits/8 - 2]);
+    oStats->ioWaitTime = 0;
+    oStats->computeTime = sceKernelGetProcessTimeWide() - computeTime;
+    return 1;
+}
+
+#ifndef READ_WITH_KUIO
+// Converted images cache: "ux0:data/FakeCamera/cache/NAME_FORMAT.bin" (NAME_FORMAT_BAYERPATTERN.bin for RAW8) holds a
+// header followed by the image planes
+// The header must match the one built from the source BMP (path, size, modification time, format, Bayer pattern of
+// RAW8 images and geometry)
+// Not available with kuio, which has no way to get the file modification time
+
+#define IMAGE_CACHE_DIR "ux0:/data/FakeCamera/cache"
+#define IMAGE_CACHE_MAGIC 0x43495046 // "FPIC"
+#define IMAGE_CACHE_VERSION 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    char sourcePath[128];
+    SceOff sourceSize;
+    SceDateTime sourceTime;
+    int32_t format;
+    int32_t bayerPattern; // "bayerPattern" setting for RAW8 images (0 otherwise)
+    uint16_t texelBits[3];
+    uint16_t rowStride[3];
+    uint16_t rowDepend[3];
+    uint16_t widthAlign;
+    uint16_t heightAlign;
+    uint16_t imageWidth;
+    uint16_t imageHeight;
+    uint32_t planeSize[3];
+} ImageCacheHeader;
+
+static int MakeImageCacheHeader(SceUID iFile, const char* iPath, SceCameraFormat iFormat, const ImageBuffers* iBuffers, ImageCacheHeader* oHeader)
+{
+    SceIoStat stat;
+    if (strlen(iPath) >= sizeof(oHeader->sourcePath) || sceIoGetstatByFd(iFile, &stat) < 0)
+        return -1;
+
+    // Zeroed padding allows comparing whole headers
+    memset(oHeader, 0, sizeof(ImageCacheHeader));
+    oHeader->magic = IMAGE_CACHE_MAGIC;
+    oHeader->version = IMAGE_CACHE_VERSION;
+    strcpy(oHeader->sourcePath, iPath);
+    oHeader->sourceSize = stat.st_size;
+    oHeader->sourceTime = stat.st_mtime;
+    oHeader->format = iFormat;
+    oHeader->bayerPattern = (SCE_CAMERA_FORMAT_RAW8 == iFormat) ? config.bayerPattern : 0;
+    for (int i = 0; i < 3; i++)
+    {
+        oHeader->texelBits[i] = iBuffers->texelBits[i];
+        oHeader->rowStride[i] = iBuffers->rowStride[i];
+        oHeader->rowDepend[i] = iBuffers->rowDepend[i];
+        oHeader->planeSize[i] = iBuffers->rowStride[i]*iBuffers->imageHeight/iBuffers->rowDepend[i];
+    }
+    oHeader->widthAlign = iBuffers->widthAlign;
+    oHeader->heightAlign = iBuffers->heightAlign;
+    oHeader->imageWidth = iBuffers->imageWidth;
+    oHeader->imageHeight = iBuffers->imageHeight;
+    return 0;
+}
+
+static void GetImageCachePath(const char* iPath, SceCameraFormat iFormat, char* oCachePath)
+{
+    const char* name = iPath;
+    for (const char* c = iPath; '\0' != *c; c++)
+    {
+        if ('/' == *c || ':' == *c)
+            name = c+1;
+    }
+    char* end = oCachePath + sprintf(oCachePath, IMAGE_CACHE_DIR "/%s", name);
+    if (end - oCachePath > 4 && '.' == end[-4])
+        end -= 4;
+    // RAW8 images converted with each Bayer pattern are kept side by side
+    if (SCE_CAMERA_FORMAT_RAW8 == iFormat)
+        sprintf(end, "_%d_%d.bin", iFormat, config.bayerPattern);
+    else
+        sprintf(end, "_%d.bin", iFormat);
+}
+
+static int LoadImageCache(const char* iCachePath, const ImageCacheHeader* iHeader, const char* iMemName, ImageBuffers* oBuffers, LoadStats* oStats)
+{
+    uint64_t startTime = sceKernelGetProcessTimeWide();
+    SceUID fd = sceIoOpen(iCachePath, SCE_O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+
+    ImageCacheHeader header;
+    int res = -1;
+    if (sizeof(header) == sceIoRead(fd, &header, sizeof(header)) && 0 == memcmp(&header, iHeader, sizeof(header)) && AllocImageBuffers(iMemName, oBuffers) >= 0)
+    {
+        res = 1;
+        for (int i = 0; i < 3 && res >= 0; i++)
+        {
+            if (header.planeSize[i] > 0 && header.planeSize[i] != sceIoRead(fd, oBuffers->blocksData[i], header.planeSize[i]))
+                res = -1;
+        }
+    }
+    sceIoClose(fd);
+
+    if (res < 0)
+        FreeImageBuffers(oBuffers);
+    oStats->ioWaitTime = sceKernelGetProcessTimeWide() - startTime;
+    oStats->computeTime = 0;
+    return res;
+}
+
+static void SaveImageCache(const char* iCachePath, const ImageCacheHeader* iHeader, const ImageBuffers* iBuffers)
+{
+    sceIoMkdir(IMAGE_CACHE_DIR, 0777);
+    SceUID fd = sceIoOpen(iCachePath, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+    if (fd < 0)
+        return;
+
+    // The valid magic is only written once planes are complete, so that an interrupted save is seen as stale
+    ImageCacheHeader header = *iHeader;
+    header.magic = 0;
+    int res = sceIoWrite(fd, &header, sizeof(header));
+    for (int i = 0; i < 3 && res >= 0; i++)
+    {
+        if (iHeader->planeSize[i] > 0 && iHeader->planeSize[i] != sceIoWrite(fd, iBuffers->blocksData[i], iHeader->planeSize[i]))
+            res = -1;
+    }
+    if (res >= 0)
+    {
+        sceIoLseek(fd, 0, SCE_SEEK_SET);
+        sceIoWrite(fd, iHeader, sizeof(ImageCacheHeader));
+    }
+    sceIoClose(fd);
+    if (res < 0)
+        sceIoRemove(iCachePath);
+}
+#endif
+
+// BMP pixels are kept in oPixels unless the image comes from the cache
+static int LoadBMPFile(SceUID iFile, const char* iPath, SceCameraFormat iFormat, char* iMemName, BitmapPixels* oPixels, ImageBuffers* oBuffers, LoadStats* oStats)
+{
+    BITMAPFILEHEADER bmp_fh;
+    ReadFile(iFile, (void *)&bmp_fh, sizeof(BITMAPFILEHEADER));
+    if (bmp_fh.bfType != BMP_SIGNATURE)
+        return -1;
+
+    BITMAPINFOHEADER bmp_ih;
+    ReadFile(iFile, (void *)&bmp_ih, sizeof(BITMAPINFOHEADER));
+
+    if (16 != bmp_ih.biBitCount && 24 != bmp_ih.biBitCount && 32 != bmp_ih.biBitCount)
+        return -1;
+
+    const CameraFormatDesc* desc = FindCameraFormat(iFormat);
+    if (NULL == desc)
+        return -1;
+
+    SetImageGeometry(desc, bmp_ih.biWidth, bmp_ih.biHeight, oBuffers);
+
+#ifndef READ_WITH_KUIO
+    ImageCacheHeader cacheHeader;
+    char cachePath[192];
+    int cacheable = (config.imageCache && MakeImageCacheHeader(iFile, iPath, iFormat, oBuffers, &cacheHeader) >= 0);
+    if (cacheable)
+    {
+        GetImageCachePath(iPath, iFormat, cachePath);
+        if (LoadImageCache(cachePath, &cacheHeader, iMemName, oBuffers, oStats) >= 0)
+            return 1;
+    }
+#endif
+
+    if (AllocImageBuffers(iMemName, oBuffers) < 0)
+        return -1;
+    
+    // Decode loop specialized for this BMP depth and camera format, or direct read when only the rows order and the
+    // bytes order differ
+    int res;
+    if (32 == bmp_ih.biBitCount && (SCE_CAMERA_FORMAT_ARGB == iFormat || SCE_CAMERA_FORMAT_ABGR == iFormat)
+        && oBuffers->imageWidth == bmp_ih.biWidth && oBuffers->imageHeight == bmp_ih.biHeight)
+        res = LoadBMPDirect(&bmp_fh, iFile, oBuffers, SCE_CAMERA_FORMAT_ABGR == iFormat, oStats);
+    else
+        res = LoadBMPGeneric(&bmp_fh, &bmp_ih, iFile, oPixels, oBuffers, desc->convert[bmp_ih.biBitCount/8 - 2], oStats);
+
+#ifndef READ_WITH_KUIO
+    if (res >= 0 && cacheable)
+        SaveImageCache(cachePath, &cacheHeader, oBuffers);
+#endif
+    return res;
+}
+
+// Image resampling to camera resolution
+// Each component is resampled on its own grid (subsampled chroma included) with 16 fractional bits positions
+
+typedef struct {
+    unsigned char* data;
+    unsigned int step;   // Bytes between two horizontal samples
+    unsigned int stride; // Bytes between two rows
+    unsigned int width;
+    unsigned int height;
+} ComponentView;
+
+static void ResampleNearest(const ComponentView* iSrc, ComponentView* oDst)
+{
+    for (unsigned int y = 0; y < oDst->height; y++)
+    {
+        const unsigned char* srcRow = iSrc->data + (unsigned int)(((uint64_t)(2*y+1)*iSrc->height)/(2*oDst->height))*iSrc->stride;
+        unsigned char* dst = oDst->data + y*oDst->stride;
+        for (unsigned int x = 0; x < oDst->width; x++)
+            dst[x*oDst->step] = srcRow[(unsigned int)(((uint64_t)(2*x+1)*iSrc->width)/(2*oDst->width))*iSrc->step];
+    }
+}
+
+// Source position (16 fractional bits) of destination sample iPos centre, clamped to the first and last source samples
+static inline unsigned int SamplePosition(unsigned int iPos, unsigned int iSrcSize, unsigned int iDstSize)
+{
+    int64_t pos = (((int64_t)(2*iPos+1)*iSrcSize)<<15)/iDstSize - 0x8000;
+    return (unsigned int)clamp(pos, 0, ((int64_t)iSrcSize-1)<<16);
+}
+
+static void ResampleBilinear(const ComponentView* iSrc, ComponentView* oDst)
+{
+    for (unsigned int y = 0; y < oDst->height; y++)
+    {
+        unsigned int posY = SamplePosition(y, iSrc->height, oDst->height);
+        unsigned int y0 = posY>>16;
+        unsigned int y1 = (y0+1 < iSrc->height) ? y0+1 : y0;
+        unsigned int wy = (posY>>4)&0xFFF;
+        const unsigned char* row0 = iSrc->data + y0*iSrc->stride;
+        const unsigned char* row1 = iSrc->data + y1*iSrc->stride;
+        unsigned char* dst = oDst->data + y*oDst->stride;
+
+        for (unsigned int x = 0; x < oDst->width; x++)
+        {
+            unsigned int posX = SamplePosition(x, iSrc->width, oDst->width);
+            unsigned int x0 = (posX>>16)*iSrc->step;
+            unsigned int x1 = ((posX>>16)+1 < iSrc->width) ? x0+iSrc->step : x0;
+            unsigned int wx = (posX>>4)&0xFFF;
+            unsigned int top = row0[x0]*(4096-wx) + row0[x1]*wx;
+            unsigned int bottom = row1[x0]*(4096-wx) + row1[x1]*wx;
+            dst[x*oDst->step] = (top*(4096-wy) + bottom*wy + (1<<23)) >> 24; // 12 bits weights, sums fit in 32 bits
+        }
+    }
+}
+
+// Only used to reduce images: each destination sample is the average of the source samples it covers
+static void ResampleBox(const ComponentView* iSrc, ComponentView* oDst)
+{
+    for (unsigned int y = 0; y < oDst->height; y++)
+    {
+        unsigned int y0 = (y*iSrc->height)/oDst->height;
+        unsigned int y1 = ((y+1)*iSrc->height)/oDst->height;
+        if (y1 <= y0) y1 = y0+1;
+        unsigned char* dst = oDst->data + y*oDst->stride;
+
+        for (unsigned int x = 0; x < oDst->width; x++)
+        {
+            unsigned int x0 = (x*iSrc->width)/oDst->width;
+            unsigned int x1 = ((x+1)*iSrc->width)/oDst->width;
+            if (x1 <= x0) x1 = x0+1;
+
+            unsigned int sum = 0;
+            for (unsigned int sy = y0; sy < y1; sy++)
+            {
+                const unsigned char* src = iSrc->data + sy*iSrc->stride + x0*iSrc->step;
+                for (unsigned int sx = x0; sx < x1; sx++, src += iSrc->step)
+                    sum += *src;
+            }
+            unsigned int count = (y1-y0)*(x1-x0);
+            dst[x*oDst->step] = (sum + count/2)/count;
+        }
+    }
+}
+
+// Size of an image resampled for iWidth x iHeight camera buffers, aligned for its format
+static void ScaledImageSize(const ImageBuffers* iImage, unsigned int iWidth, unsigned int iHeight, int iScaling, unsigned int* oWidth, unsigned int* oHeight)
+{
+    unsigned int width = iWidth;
+    unsigned int height = iHeight;
+    int wider = ((uint64_t)iImage->imageWidth*iHeight > (uint64_t)iWidth*iImage->imageHeight);
+    if ((IMAGE_SCALING_FIT == iScaling && wider) || (IMAGE_SCALING_FILL == iScaling && !wider))
+        height = ((uint64_t)iImage->imageHeight*iWidth + iImage->imageWidth/2)/iImage->imageWidth;
+    else if (IMAGE_SCALING_FIT == iScaling || IMAGE_SCALING_FILL == iScaling)
+        width = ((uint64_t)iImage->imageWidth*iHeight + iImage->imageHeight/2)/iImage->imageHeight;
+
+    width = (width/iImage->widthAlign)*iImage->widthAlign;
+    height = (height/iImage->heightAlign)*iImage->heightAlign;
+    *oWidth = (width > 0) ? width : iImage->widthAlign;
+    *oHeight = (height > 0) ? height : iImage->heightAlign;
+}
+
+// Resamples iImage (converted to iDesc format) in oBuffers for iWidth x iHeight camera buffers
+static int ScaleImage(const ImageBuffers* iImage, const CameraFormatDesc* iDesc, unsigned int iWidth, unsigned int iHeight, const char* iMemName, ImageBuffers* oBuffers)
+{
+    unsigned int width, height;
+    ScaledImageSize(iImage, iWidth, iHeight, config.imageScaling, &width, &height);
+    SetImageGeometry(iDesc, width, height, oBuffers);
+    if (AllocImageBuffers(iMemName, oBuffers) < 0)
+        return -1;
+
+    const ImageComponent* components = cameraFormatComponents[iDesc - cameraFormats];
+    for (int i = 0; i < MAX_IMAGE_COMPONENTS && components[i].step > 0; i++)
+    {
+        const ImageComponent* comp = &components[i];
+        unsigned int srcStride = iImage->rowStride[comp->plane];
+        unsigned int dstStride = oBuffers->rowStride[comp->plane];
+        ComponentView src = { (unsigned char*)iImage->blocksData[comp->plane] + comp->row*srcStride + comp->offset, comp->step, comp->rowStep*srcStride,
+                              iImage->imageWidth/comp->subWidth, iImage->imageHeight/comp->subHeight };
+        ComponentView dst = { (unsigned char*)oBuffers->blocksData[comp->plane] + comp->row*dstStride + comp->offset, comp->step, comp->rowStep*dstStride,
+                              oBuffers->imageWidth/comp->subWidth, oBuffers->imageHeight/comp->subHeight };
+
+        if (SCALING_FILTER_NEAREST == config.scalingFilter)
+            ResampleNearest(&src, &dst);
+        else if (SCALING_FILTER_BOX == config.scalingFilter && dst.width <= src.width && dst.height <= src.height)
+            ResampleBox(&src, &dst);
+        else
+            ResampleBilinear(&src, &dst);
+    }
+    return 1;
+}
+
+// Video streaming functions
+// Sources are "NAME.y4m" files or headerless "NAME.yuv" files described by "NAME.yuv.cfg" (same syntax as the plugin
+// configuration with "width", "height", "frameRate" and "frameRateScale" values), both with 8 bits YUV 4:2:0 frames
+// A helper thread reads and converts frames ahead in a ring, the read hook showing the latest one due without waiting
+
+typedef struct {
+    SceUID file;
+    unsigned int dataOffset;      // Offset of the first frame
+    unsigned int frameHeaderSize; // "FRAME" line before each Y4M frame
+    unsigned int width;
+    unsigned int height;
+    unsigned int rateNum;         // Frame rate as a fraction
+    unsigned int rateDen;
+    const CameraFormatDesc* desc;
+    SceUID stagingID;
+    unsigned char* staging;       // Source frame, when it has to be converted
+    unsigned int ringSize;
+    ImageBuffers frames[MAX_VIDEO_RING_FRAMES];
+    volatile unsigned int produced; // Frames written in the ring so far
+    volatile unsigned int shown;    // Frame shown by the read hook, never overwritten
+    volatile int state;             // 0 running, 1 stop requested, -1 no readable frame
+    SceUID wakeSema;
+    SceUID thread;
+    uint64_t cameraBase;            // Camera frame when videoBase was shown (camera frames restart with sceCameraStart)
+    uint64_t lastCameraFrame;
+    unsigned int videoBase;
+} VideoStream;
+
+// 8 bits 4:2:0 color spaces (chroma siting doesn't matter here), higher bit depths like "420p10" aren't
+static int IsY4M420ColorSpace(const char* iToken)
+{
+    static const char* names[] = { "420", "420jpeg", "420paldv", "420mpeg2" };
+    size_t length = strcspn(iToken, " ");
+    for (int i = 0; i < sizeof(names)/sizeof(names[0]); i++)
+    {
+        if (length == strlen(names[i]) && 0 == memcmp(iToken, names[i], length))
+            return 1;
+    }
+    return 0;
+}
+
+static int ParseY4MHeader(VideoStream* ioStream)
+{
+    char header[128];
+    SeekFile(ioStream->file, 0);
+    int size = ReadFile(ioStream->file, header, sizeof(header)-1);
+    if (size < 10 || 0 != memcmp(header, "YUV4MPEG2 ", 10))
+        return -1;
+    header[size] = '\0';
+
+    char* end = strchr(header, '\n');
+    if (NULL == end)
+        return -1;
+    *end = '\0';
+    ioStream->dataOffset = end + 1 - header;
+
+    ioStream->rateNum = 30;
+    ioStream->rateDen = 1;
+    for (char* token = header + 10; NULL != token; token = strchr(token, ' '))
+    {
+        while (' ' == *token)
+            token++;
+        if ('W' == token[0])
+            ioStream->width = ParseInt(token+1);
+        else if ('H' == token[0])
+            ioStream->height = ParseInt(token+1);
+        else if ('F' == token[0] && NULL != strchr(token, ':'))
+        {
+            ioStream->rateNum = ParseInt(token+1);
+            ioStream->rateDen = ParseInt(strchr(token, ':')+1);
+        }
+        else if ('C' == token[0] && !IsY4M420ColorSpace(token+1))
+            return -1;
+    }
+
+    // Frame parameters are assumed to stay the same for the whole stream
+    SeekFile(ioStream->file, ioStream->dataOffset);
+    size = ReadFile(ioStream->file, header, 64);
+    if (size < 6 || 0 != memcmp(header, "FRAME", 5))
+        return -1;
+    header[size] = '\0';
+    end = strchr(header, '\n');
+    if (NULL == end)
+        return -1;
+    ioStream->frameHeaderSize = end + 1 - header;
+    return 0;
+}
+
+static int ParseYUVDescriptor(VideoStream* ioStream, const char* iPath)
+{
+    char text[256];
+    char pathname[72];
+    sprintf(pathname, "%s.cfg", iPath);
+    SceUID fd = OpenFile(pathname);
+    if (fd < 0)
+        return -1;
+    int size = ReadFile(fd, text, sizeof(text)-1);
+    CloseFile(fd);
+    if (size <= 0)
+        return -1;
+    text[size] = '\0';
+
+    int width = 0, height = 0, rateNum = 30, rateDen = 1;
+    const ConfigEntry entries[] = {
+        { "width", &width },
+        { "height", &height },
+        { "frameRate", &rateNum },
+        { "frameRateScale", &rateDen },
+    };
+    ParseConfig(text, entries, sizeof(entries)/sizeof(entries[0]));
+
+    ioStream->width = width;
+    ioStream->height = height;
+    ioStream->rateNum = rateNum;
+    ioStream->rateDen = rateDen;
+    ioStream->dataOffset = 0;
+    ioStream->frameHeaderSize = 0;
+    return 0;
+}
+
+static int ReadVideoFrame(VideoStream* ioStream, const ImageBuffers* oFrame)
+{
+    char header[64];
+    if (ioStream->frameHeaderSize > 0 && (ioStream->frameHeaderSize != ReadFile(ioStream->file, header, ioStream->frameHeaderSize) || 0 != memcmp(header, "FRAME", 5)))
+        return -1;
+
+    unsigned int lumaSize = ioStream->width*ioStream->height;
+    unsigned int chromaSize = lumaSize/4;
+    if (NULL == ioStream->desc->convertVideo)
+    {
+        // Planes with the same layout as the file
+        if (lumaSize != ReadFile(ioStream->file, oFrame->blocksData[0], lumaSize) ||
+            chromaSize != ReadFile(ioStream->file, oFrame->blocksData[1], chromaSize) ||
+            chromaSize != ReadFile(ioStream->file, oFrame->blocksData[2], chromaSize))
+            return -1;
+    }
+    else
+    {
+        if (lumaSize + 2*chromaSize != ReadFile(ioStream->file, ioStream->staging, lumaSize + 2*chromaSize))
+            return -1;
+        ioStream->desc->convertVideo(ioStream->staging, ioStream->width, ioStream->height, oFrame);
+    }
+    return 0;
+}
+
+static int VideoStreamThread(SceSize args, void *argp)
+{
+    VideoStream* stream = *(VideoStream**)argp;
+    int failures = 0;
+    while (0 == stream->state)
+    {
+        if (stream->produced - stream->shown >= stream->ringSize)
+        {
+            SceUInt32 timeout = 100000;
+            sceKernelWaitSema(stream->wakeSema, 1, &timeout);
+            continue;
+        }
+
+        if (ReadVideoFrame(stream, &stream->frames[stream->produced % stream->ringSize]) < 0)
+        {
+            // Loops at end of file
+            if (++failures > 1)
+                stream->state = -1;
+            SeekFile(stream->file, stream->dataOffset);
+            continue;
+        }
+        failures = 0;
+        __sync_synchronize();
+        stream->produced++;
+    }
+    return 0;
+}
+
+static void StopVideoStream(VideoStream* ioStream)
+{
+    if (ioStream->thread >= 0)
+    {
+        if (ioStream->state >= 0)
+            ioStream->state = 1;
+        sceKernelSignalSema(ioStream->wakeSema, 1);
+        sceKernelWaitThreadEnd(ioStream->thread, NULL, NULL);
+        sceKernelDeleteThread(ioStream->thread);
+    }
+    if (ioStream->wakeSema >= 0)
+        sceKernelDeleteSema(ioStream->wakeSema);
+    FreeMemory(ioStream->stagingID, ioStream->staging);
+    for (int i = 0; i < MAX_VIDEO_RING_FRAMES; i++)
+        FreeImageBuffers(&ioStream->frames[i]);
+    if (ioStream->file >= 0)
+        CloseFile(ioStream->file);
+
+    ioStream->thread = -1;
+    ioStream->wakeSema = -1;
+    ioStream->stagingID = -1;
+    ioStream->staging = NULL;
+    ioStream->file = -1;
+}
+
+// Takes ownership of iFile, returns once the first frame is converted
+static int StartVideoStream(VideoStream* oStream, SceUID iFile, const char* iPath, SceCameraFormat iFormat, const char* iMemName)
+{
+    ImageBuffers buffersInit = IMAGE_BUFFERS_INIT;
+    for (int i = 0; i < MAX_VIDEO_RING_FRAMES; i++)
+        oStream->frames[i] = buffersInit;
+    oStream->file = iFile;
+    oStream->thread = -1;
+    oStream->wakeSema = -1;
+    oStream->stagingID = -1;
+    oStream->staging = NULL;
+    oStream->produced = 0;
+    oStream->shown = 0;
+    oStream->state = 0;
+    oStream->cameraBase = 0;
+    oStream->lastCameraFrame = 0;
+    oStream->videoBase = 0;
+    oStream->width = 0;
+    oStream->height = 0;
+    oStream->desc = FindCameraFormat(iFormat);
+    oStream->ringSize = config.videoRingFrames;
+
+    int res = HasExtension(iPath, ".y4m") ? ParseY4MHeader(oStream) : ParseYUVDescriptor(oStream, iPath);
+    if (res < 0 || NULL == oStream->desc || 0 == oStream->width || 0 == oStream->height || (oStream->width|oStream->height) & 1 ||
+        0 == oStream->rateNum || 0 == oStream->rateDen)
+    {
+        StopVideoStream(oStream);
+        return -1;
+    }
+
+    for (int i = 0; i < oStream->ringSize; i++)
+    {
+        char memname[64];
+        snprintf(memname, sizeof(memname), "%s_%d", iMemName, i);
+        SetImageGeometry(oStream->desc, oStream->width, oStream->height, &oStream->frames[i]);
+        if (AllocImageBuffers(memname, &oStream->frames[i]) < 0)
+        {
+            StopVideoStream(oStream);
+            return -1;
+        }
+    }
+    if (NULL != oStream->desc->convertVideo)
+    {
+        oStream->staging = AllocMemory("video_block", oStream->width*oStream->height*3/2, &oStream->stagingID);
+        if (NULL == oStream->staging)
+        {
+            StopVideoStream(oStream);
+            return -1;
+        }
+    }
+
+    SeekFile(oStream->file, oStream->dataOffset);
+    oStream->wakeSema = sceKernelCreateSema("fakecamera_video", 0, 0, 1, NULL);
+    if (oStream->wakeSema >= 0)
+        oStream->thread = sceKernelCreateThread("fakecamera_video", &VideoStreamThread, 0x10000100, 0x2000, 0, 0, NULL);
+    if (oStream->thread < 0 || sceKernelStartThread(oStream->thread, sizeof(oStream), &oStream) < 0)
+    {
+        StopVideoStream(oStream);
+        return -1;
+    }
+
+    while (0 == oStream->produced && oStream->state >= 0)
+        sceKernelDelayThread(1000);
+    if (0 == oStream->produced)
+    {
+        StopVideoStream(oStream);
+        return -1;
+    }
+    return 0;
+}
+
+// Ring frame to show at camera frame iFrame of a camera running at iRateNum/iRateDen frames per second, the latest
+// converted one when reading is late
+static unsigned int NextVideoFrame(VideoStream* ioStream, uint64_t iFrame, uint64_t iRateNum, uint64_t iRateDen)
+{
+    if (iFrame < ioStream->lastCameraFrame)
+    {
+        ioStream->cameraBase = iFrame;
+        ioStream->videoBase = ioStream->shown;
+    }
+    ioStream->lastCameraFrame = iFrame;
+
+    unsigned int target = ioStream->produced - 1;
+    __sync_synchronize();
+    if (iRateNum > 0)
+    {
+        uint64_t videoFrame = ioStream->videoBase + ((iFrame-ioStream->cameraBase)*ioStream->rateNum*iRateDen)/(iRateNum*ioStream->rateDen);
+        if (videoFrame < target)
+            target = videoFrame;
+    }
+    if (target > ioStream->shown)
+    {
+        ioStream->shown = target;
+        sceKernelSignalSema(ioStream->wakeSema, 1);
+    }
+    return ioStream->shown;
+}
+
+//#define bitSize(size, bits) ((size*bits)/8)
+unsigned int bitSize(unsigned int size, unsigned int bits)
+{
+    return (size*bits) / 8;
+}
+
+// Camera buffers blit
+
+// Content of a camera buffers triple: the image area copied at (bufX, bufY), everything else is black
+typedef struct {
+    void* buffers[3];
+    const CameraFormatDesc* desc;
+    unsigned int bufWidth;
+    unsigned int bufHeight;
+    int generation;          // Image generation copied (0 for a black frame, -1 when the content is unknown)
+    unsigned int videoFrame;
+    unsigned int imgX, imgY; // Top-left position of the copied area in the image
+    unsigned int bufX, bufY; // Top-left position of the copied area in camera buffers
+    unsigned int width, height;
+} BlitState;
+
+#define BLIT_STATE_INIT { {NULL, NULL, NULL}, NULL, 0, 0, -1, 0, 0, 0, 0, 0, 0, 0 }
+
+// Fills rows [iRow0, iRow1) and columns [iX0, iX1) of a plane with its black pattern (rows and columns in plane units)
+static void FillPlaneArea(char* oPlane, unsigned int iPattern, unsigned int iBits, unsigned int iRowTexels,
+                          unsigned int iX0, unsigned int iX1, unsigned int iRow0, unsigned int iRow1)
+{
+    if (iX0 >= iX1 || iRow0 >= iRow1)
+        return;
+
+    if (0 == iX0 && iRowTexels == iX1)
+    {
+        FillPattern(oPlane+bitSize(iRow0*iRowTexels,iBits), iPattern, bitSize((iRow1-iRow0)*iRowTexels,iBits));
+        return;
+    }
+
+    for (unsigned int row = iRow0; row < iRow1; row++)
+        FillPattern(oPlane+bitSize(row*iRowTexels+iX0,iBits), iPattern, bitSize(iX1-iX0,iBits));
+}
+
+// Same image area at the same place
+static int SameBlitContent(const BlitState* iState1, const BlitState* iState2)
+{
+    return (iState1->generation == iState2->generation && iState1->videoFrame == iState2->videoFrame
+            && iState1->imgX == iState2->imgX && iState1->imgY == iState2->imgY && iState1->bufX == iState2->bufX && iState1->bufY == iState2->bufY
+            && iState1->width == iState2->width && iState1->height == iState2->height);
+}
+
+#define BLIT_UNCHANGED 0
+#define BLIT_UPDATED   1
+#define BLIT_REWRITTEN 2
+
+// Copies the image area described by iTarget in camera buffers, only clearing the parts of the previous image area (ioState) which are no longer covered
+// Everything is rewritten when buffers, format or resolution differ from ioState, copied image bytes are added to ioCopied (may be NULL)
+static int BlitImage(BlitState* ioState, const BlitState* iTarget, const ImageBuffers* iImage, uint64_t* ioCopied)
+{
+    const CameraFormatDesc* desc = iTarget->desc;
+    if (NULL == desc)
+        return BLIT_UNCHANGED;
+
+    int fresh = (ioState->generation < 0 || ioState->desc != desc || ioState->bufWidth != iTarget->bufWidth || ioState->bufHeight != iTarget->bufHeight
+                 || ioState->buffers[0] != iTarget->buffers[0] || ioState->buffers[1] != iTarget->buffers[1] || ioState->buffers[2] != iTarget->buffers[2]);
+
+    if (!fresh && SameBlitContent(ioState, iTarget))
+        return BLIT_UNCHANGED;
+
+    // Previously copied area (whole buffers when their content is unknown)
+    unsigned int oldX0 = fresh ? 0 : ioState->bufX;
+    unsigned int oldY0 = fresh ? 0 : ioState->bufY;
+    unsigned int oldX1 = fresh ? iTarget->bufWidth : ioState->bufX+ioState->width;
+    unsigned int oldY1 = fresh ? iTarget->bufHeight : ioState->bufY+ioState->height;
+
+    unsigned int newX0 = iTarget->bufX;
+    unsigned int newY0 = iTarget->bufY;
+    unsigned int newX1 = iTarget->bufX+iTarget->width;
+    unsigned int newY1 = iTarget->bufY+iTarget->height;
+    if (NULL == iImage || 0 == iTarget->width || 0 == iTarget->height)
+    {
+        newX1 = newX0;
+        newY1 = newY0;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        char* plane = (char*)iTarget->buffers[i];
+        if (NULL == plane || 0 == desc->texelBits[i])
+            continue;
+
+        unsigned int rowDepend = desc->rowDepend[i];
+        unsigned int bits = desc->texelBits[i]*rowDepend;
+        unsigned int rowTexels = iTarget->bufWidth;
+        unsigned int pattern = desc->black[i];
+
+        // Old area minus new area: rows above and below, then columns on both sides
+        unsigned int oldRow0 = oldY0/rowDepend, oldRow1 = oldY1/rowDepend;
+        unsigned int newRow0 = newY0/rowDepend, newRow1 = newY1/rowDepend;
+        FillPlaneArea(plane, pattern, bits, rowTexels, oldX0, oldX1, oldRow0, (oldRow1 < newRow0) ? oldRow1 : newRow0);
+        FillPlaneArea(plane, pattern, bits, rowTexels, oldX0, oldX1, (oldRow0 > newRow1) ? oldRow0 : newRow1, oldRow1);
+
+        unsigned int midRow0 = (oldRow0 > newRow0) ? oldRow0 : newRow0;
+        unsigned int midRow1 = (oldRow1 < newRow1) ? oldRow1 : newRow1;
+        FillPlaneArea(plane, pattern, bits, rowTexels, oldX0, (oldX1 < newX0) ? oldX1 : newX0, midRow0, midRow1);
+        FillPlaneArea(plane, pattern, bits, rowTexels, (oldX0 > newX1) ? oldX0 : newX1, oldX1, midRow0, midRow1);
+
+        char* image = (NULL != iImage && iImage->blockIDs[i] >= 0) ? (char*)iImage->blocksData[i] : NULL;
+        if (NULL != image && newRow0 < newRow1)
+        {
+            unsigned int imgStride = iImage->rowStride[i];
+            unsigned int rowSize = bitSize(newX1-newX0,bits);
+            char* dst = plane+bitSize(newRow0*rowTexels+newX0,bits);
+            const char* src = image+(iTarget->imgY/rowDepend)*imgStride+bitSize(iTarget->imgX,bits);
+            if (NULL != ioCopied)
+                *ioCopied += (newRow1-newRow0)*rowSize;
+
+            if (rowSize == imgStride && rowSize == bitSize(rowTexels,bits))
+                memcpy(dst, src, (newRow1-newRow0)*rowSize);
+            else
+            {
+                for (unsigned int row = newRow0; row < newRow1; row++)
+                {
+                    memcpy(dst, src, rowSize);
+                    dst += bitSize(rowTexels,bits);
+                    src += imgStride;
+                }
+            }
+        }
+    }
 
-#ifdef ENABLE_BMP
-static uint16_t width[NB_CAM] = {0, 0};
-static uint16_t height[NB_CAM] = {0, 0};
-static SceCameraFormat format[NB_CAM] = {0, 0};
+    *ioState = *iTarget;
+    if (newX0 == newX1)
+    {
+        ioState->width = 0;
+        ioState->height = 0;
+    }
+    return fresh ? BLIT_REWRITTEN : BLIT_UPDATED;
+}
 
-static void* IBufferOnOpen[NB_CAM] = {NULL, NULL};
-static void* UBufferOnOpen[NB_CAM] = {NULL, NULL};
-static void* VBufferOnOpen[NB_CAM] = {NULL, NULL};
+// Content of the last camera buffers written by a camera, titles may rotate several buffers
+#define BLIT_CACHE_SIZE 4
 
-static ImageBuffers imageBuffers[NB_CAM] = { { {-1, -1, -1}, {NULL, NULL, NULL}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, 0, 0, 0, -1} ,
-                                             { {-1, -1, -1}, {NULL, NULL, NULL}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, 0, 0, 0, -1} };
-static SceCameraFormat imageFormat[NB_CAM] = {0, 0};
+typedef struct {
+    BlitState entries[BLIT_CACHE_SIZE];
+    unsigned int lastUse[BLIT_CACHE_SIZE];
+    unsigned int useClock;
+    unsigned int hits;       // Reads where buffers already held the expected frame
+    unsigned int updates;    // Reads where only a part of buffers was written
+    unsigned int rewrites;   // Reads where buffers were fully written
+    uint64_t copiedBytes;    // Image bytes copied in buffers
+} BlitCache;
+
+static void ResetBlitCache(BlitCache* oCache)
+{
+    BlitState stateInit = BLIT_STATE_INIT;
+    for (int i = 0; i < BLIT_CACHE_SIZE; i++)
+    {
+        oCache->entries[i] = stateInit;
+        oCache->lastUse[i] = 0;
+    }
+    oCache->useClock = 0;
+}
 
-static int prevWidthOffset[NB_CAM] = {-1, -1};
-static int prevHeightOffset[NB_CAM] = {-1, -1};
-static void* prevBuffers[NB_CAM][3] = { {NULL, NULL, NULL}, {NULL, NULL, NULL} };
-#endif
+// Entry describing iBuffers content, the least recently used entry is recycled for unknown buffers
+static BlitState* GetBlitState(BlitCache* ioCache, void* const iBuffers[3])
+{
+    int oldest = 0;
+    for (int i = 0; i < BLIT_CACHE_SIZE; i++)
+    {
+        BlitState* entry = &ioCache->entries[i];
+        if (entry->buffers[0] == iBuffers[0] && entry->buffers[1] == iBuffers[1] && entry->buffers[2] == iBuffers[2])
+        {
+            ioCache->lastUse[i] = ++ioCache->useClock;
+            return entry;
+        }
+        if (ioCache->lastUse[i] < ioCache->lastUse[oldest])
+            oldest = i;
+    }
 
-static int cameraOpened[NB_CAM] = {0, 0};
-static uint16_t framerate[NB_CAM];
-static uint64_t prevFrame[NB_CAM] = {0, 0};
+    BlitState stateInit = BLIT_STATE_INIT;
+    BlitState* entry = &ioCache->entries[oldest];
+    *entry = stateInit;
+    for (int i = 0; i < 3; i++)
+        entry->buffers[i] = iBuffers[i];
+    ioCache->lastUse[oldest] = ++ioCache->useClock;
+    return entry;
+}
 
-static tai_hook_ref_t ref_hook0;
-static int hook_sceCameraOpen(int devnum, SceCameraInfo *pInfo)
+// Writes iTarget in iBuffers with counters update
+static void BlitCachedImage(BlitCache* ioCache, void* const iBuffers[3], const BlitState* iTarget, const ImageBuffers* iImage)
 {
-    int res = TAI_CONTINUE(int, ref_hook0, devnum, pInfo);
-    
-    if ((unsigned int)devnum < NB_CAM && NULL != pInfo && !cameraOpened[devnum])
+    BlitState target = *iTarget;
+    for (int i = 0; i < 3; i++)
+        target.buffers[i] = iBuffers[i];
+
+    switch (BlitImage(GetBlitState(ioCache, iBuffers), &target, iImage, &ioCache->copiedBytes))
     {
-        cameraOpened[devnum] = 1;
-        framerate[devnum] = pInfo->framerate;
+        case BLIT_UNCHANGED: ioCache->hits++; break;
+        case BLIT_UPDATED: ioCache->updates++; break;
+        default: ioCache->rewrites++; break;
+    }
+}
 
-        if (res < 0 && pInfo->resolution > SCE_CAMERA_RESOLUTION_0_0 && pInfo->resolution <= SCE_CAMERA_RESOLUTION_640_360)
+// Math functions (used by motion detection)
+
+
+#define M_PI 3.14159265359f
+
+float atan2_approx(float y, float x)
+{
+    static float ONEQTR_PI = M_PI / 4.0;
+	static float THRQTR_PI = 3.0 * M_PI / 4.0;
+	float r, angle;
+	float abs_y = abs(y) + 1e-10f;
+	if ( x < 0.0f )
+	{
+		r = (x + abs_y) / (abs_y - x);
+		angle = THRQTR_PI;
+	}
+	else
+	{
+		r = (x - abs_y) / (x + abs_y);
+		angle = ONEQTR_PI;
+	}
+	angle += (0.1963f * r * r - 0.9817f) * r;
+	if ( y < 0.0f )
+		return -angle;
+
+    return angle;
+}
+
+// Motion sampling: image scrolling rates (from -1 to 1 on each axis) given by the PS Vita orientation
+// A helper thread samples DSMotion "motionRate" times per second and publishes low-pass filtered rates in a slot protected
+// by a sequence counter, so that frames get the latest rates without any kernel call (rates are sampled by frames when 0)
+
+static int SampleMotionRates(float* oWidthRate, float* oHeightRate)
+{
+    signed short accel[3];
+    signed short gyro[3];
+    if (dsGetSampledAccelGyro(100, accel, gyro) < 0)
+        return -1;
+
+    SceFVector3 accelVec = {-(float)accel[2] / 0x2000, (float)accel[0] / 0x2000, -(float)accel[1] / 0x2000};
+
+    float pitch = atan2_approx(accelVec.z, -accelVec.y);
+    float roll = atan2_approx(-accelVec.x, -accelVec.z*sign(-pitch));
+
+    *oWidthRate = clamp(-roll, -1.f, 1.f);
+    *oHeightRate = clamp(-(pitch+M_PI/2.f), -1.f, 1.f);
+    return 0;
+}
+
+typedef struct {
+    volatile unsigned int sequence; // Odd while rates are written
+    float widthRate;
+    float heightRate;
+    int valid;
+} MotionSlot;
+
+static MotionSlot motionSlot = { 0, 0.f, 0.f, 0 };
+static SceUID motionThread = -1;
+static volatile int motionStop = 0;
+
+static int MotionSamplerThread(SceSize args, void *argp)
+{
+    float widthRate = 0.f;
+    float heightRate = 0.f;
+    float smoothing = (float)config.motionSmoothing / 100.f; // Part of the previous rates kept by each sample
+    int valid = 0;
+
+    while (!motionStop)
+    {
+        float newWidthRate, newHeightRate;
+        if (SampleMotionRates(&newWidthRate, &newHeightRate) >= 0)
         {
-            if (pInfo->resolution < SCE_CAMERA_RESOLUTION_352_288)
-            {
-                pInfo->width = (640 >> (pInfo->resolution-1));
-                pInfo->height = (480 >> (pInfo->resolution-1));
-            }
-            else if (pInfo->resolution < SCE_CAMERA_RESOLUTION_480_272)
-            {
-                pInfo->width = (352 >> (pInfo->resolution-4));
-                pInfo->height = (288 >> (pInfo->resolution-4));
-            }
-            else if (SCE_CAMERA_RESOLUTION_480_272 == pInfo->resolution)
-            {
-                pInfo->width = 480;
-                pInfo->height = 272;
-            }
-            else if (SCE_CAMERA_RESOLUTION_640_360 == pInfo->resolution)
-            {
-                pInfo->width = 640;
-                pInfo->height = 360;
-            }
-        
-        #ifdef ENABLE_BMP
-            width[devnum] = pInfo->width;
-            height[devnum] = pInfo->height;
-            if (0 == pInfo->buffer)
-            {
-                IBufferOnOpen[devnum] = pInfo->pIBase;
-                UBufferOnOpen[devnum] = pInfo->pUBase;
-                VBufferOnOpen[devnum] = pInfo->pVBase;
-            }
-            format[devnum] = pInfo->format;
-            
-            //LOG("Camera opened %d with format %d\n", devnum, pInfo->format);
-            //LOG("Buffers pointers %x, %x, %x\n", (unsigned int)pInfo->pIBase, (unsigned int)pInfo->pUBase, (unsigned int)pInfo->pVBase);
-            //log_flush();
+            widthRate = valid ? widthRate*smoothing + newWidthRate*(1.f-smoothing) : newWidthRate;
+            heightRate = valid ? heightRate*smoothing + newHeightRate*(1.f-smoothing) : newHeightRate;
+            valid = 1;
+
+            motionSlot.sequence++;
+            __sync_synchronize();
+            motionSlot.widthRate = widthRate;
+            motionSlot.heightRate = heightRate;
+            motionSlot.valid = 1;
+            __sync_synchronize();
+            motionSlot.sequence++;
+        }
+        sceKernelDelayThread(1000000/config.motionRate);
+    }
+    return 0;
+}
 
-            ImageBuffers* imageBuf = &imageBuffers[devnum];
-            if (imageBuf->ready < 0 || imageFormat[devnum] != pInfo->format)
-            {
-                imageBuf->ready = 0;
-                for (int i = 0; i < 3; i++)
-                {
-                    if (imageBuf->blockIDs[i] >= 0 )
-                    {
-                        sceKernelFreeMemBlock(imageBuf->blockIDs[i]);
-                        imageBuf->blockIDs[i] = -1;
-                    }
-                }
-                
-                char memname[32];
-                char pathname[256];
-                char* camname = (1 == devnum)?"Back":"Front";
-                sprintf(memname, "%s_%s", titleid, camname);
-                sprintf(pathname, "ux0:/data/FakeCamera/%s.bmp", memname);
-            #ifdef READ_WITH_KUIO
-                SceUID fd = -1;
-                kuIoOpen(pathname, SCE_O_RDONLY, &fd);
-            #else
-                SceUID fd = sceIoOpen(pathname, SCE_O_RDONLY, 0666);
-            #endif
-                if (fd < 0)
-                {
-                    sprintf(pathname, "ux0:/data/FakeCamera/%s.bmp", titleid);
-                #ifdef READ_WITH_KUIO
-                    kuIoOpen(pathname, SCE_O_RDONLY, &fd);
-                #else
-                    fd = sceIoOpen(pathname, SCE_O_RDONLY, 0666);
-                #endif
-                }
-                if (fd < 0)
-                {
-                    sprintf(pathname, "ux0:/data/FakeCamera/ALL_%s.bmp", camname);
-                #ifdef READ_WITH_KUIO
-                    kuIoOpen(pathname, SCE_O_RDONLY, &fd);
-                #else
-                    fd = sceIoOpen(pathname, SCE_O_RDONLY, 0666);
-                #endif
-                }
-                if (fd < 0)
-                {
-                    sprintf(pathname, "ux0:/data/FakeCamera/ALL.bmp");
-                #ifdef READ_WITH_KUIO
-                    kuIoOpen(pathname, SCE_O_RDONLY, &fd);
-                #else
-                    fd = sceIoOpen(pathname, SCE_O_RDONLY, 0666);
-                #endif
-                }
-                if (fd >= 0)
-                {
-                    //LOG("Try to load file %s\n", pathname);
-                    if (LoadBMPFile(fd, pInfo->format, memname, imageBuf) >= 0)
-                    {
-                        imageFormat[devnum] = pInfo->format;
-                        imageBuf->ready = 1;
-                        //LOG(" => Success\n");
-                    }
-                    else
-                    {
-                        imageFormat[devnum] = SCE_CAMERA_FORMAT_INVALID;
-                        imageBuf->ready = -1;
-                        //LOG(" => Failed\n");
-                    }
-                    //log_flush();
-                #ifdef READ_WITH_KUIO
-                    kuIoClose(fd);
-                #else
-                    sceIoClose(fd);
-                #endif
-                }
-            }
-        #endif
+static int GetMotionRates(float* oWidthRate, float* oHeightRate)
+{
+    if (motionThread < 0)
+        return SampleMotionRates(oWidthRate, oHeightRate);
 
-            res = 0;
+    unsigned int sequence;
+    int valid;
+    do
+    {
+        sequence = motionSlot.sequence;
+        __sync_synchronize();
+        *oWidthRate = motionSlot.widthRate;
+        *oHeightRate = motionSlot.heightRate;
+        valid = motionSlot.valid;
+        __sync_synchronize();
+    } while ((sequence & 1) || sequence != motionSlot.sequence);
+
+    return valid ? 0 : -1;
+}
+
+static void StartMotionSampler(void)
+{
+    if (motionThread >= 0 || config.motionRate <= 0)
+        return;
+
+    motionStop = 0;
+    motionSlot.valid = 0;
+    motionThread = sceKernelCreateThread("fakecamera_motion", &MotionSamplerThread, 0x10000100, 0x1000, 0, 0, NULL);
+    if (motionThread >= 0 && sceKernelStartThread(motionThread, 0, NULL) < 0)
+    {
+        sceKernelDeleteThread(motionThread);
+        motionThread = -1;
+    }
+}
+
+static void StopMotionSampler(void)
+{
+    if (motionThread < 0)
+        return;
+
+    motionStop = 1;
+    sceKernelWaitThreadEnd(motionThread, NULL, NULL);
+    sceKernelDeleteThread(motionThread);
+    motionThread = -1;
+}
+
+// Trace
+// Camera hooks and image loads write fixed size records in a lock-free ring (a few stores per event), a low priority
+// thread appends them to TRACE_PATH, which is rewritten on each launch
+// Record numbers are consecutive, a gap in the file means that the writing thread was overtaken
+// Not available with kuio, which can't write files (the ring is never allocated, so events are not recorded)
+
+#define TRACE_PATH        "ux0:data/FakeCamera/trace.bin"
+#define TRACE_MAGIC       0x52544346 // "FCTR"
+#define TRACE_VERSION     1
+#define TRACE_RING_SIZE   4096 // Records, power of 2
+#define TRACE_FLUSH_DELAY 200000
+
+#define TRACE_OPEN       0
+#define TRACE_CLOSE      1
+#define TRACE_START      2
+#define TRACE_STOP       3
+#define TRACE_READ       4
+#define TRACE_IMAGE_LOAD 5
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t startTime;
+} TraceHeader;
+
+typedef struct {
+    uint32_t number;    // Record number + 1, set once the record is complete
+    uint8_t event;      // TRACE_*
+    uint8_t devnum;
+    uint16_t reserved;
+    uint64_t timestamp; // Event start (process time in microseconds)
+    uint32_t fakeFrame; // Camera frame given to the title (reads)
+    uint32_t bytes;     // Image bytes copied in camera buffers (reads) or converted (image loads)
+    uint32_t duration;  // Microseconds
+    int32_t result;     // Hook or loader result
+} TraceRecord;
+
+static TraceRecord* traceRing = NULL;
+static uint32_t traceHead = 0; // Next record number to write
+
+static void TraceEvent(int iEvent, int iDevnum, uint64_t iStart, uint32_t iFakeFrame, uint32_t iBytes, int iResult)
+{
+    if (NULL == traceRing)
+        return;
+
+    uint64_t end = sceKernelGetProcessTimeWide();
+    uint32_t number = __sync_fetch_and_add(&traceHead, 1);
+    TraceRecord* record = &traceRing[number & (TRACE_RING_SIZE-1)];
+    record->number = 0;
+    __sync_synchronize();
+    record->event = iEvent;
+    record->devnum = iDevnum;
+    record->timestamp = iStart;
+    record->fakeFrame = iFakeFrame;
+    record->bytes = iBytes;
+    record->duration = end - iStart;
+    record->result = iResult;
+    __sync_synchronize();
+    record->number = number + 1;
+}
+
+#ifndef READ_WITH_KUIO
+static SceUID traceBlock = -1;
+static SceUID traceFile = -1;
+static SceUID traceThread = -1;
+static volatile int traceStop = 0;
+static uint32_t traceTail = 0; // Next record number to flush (trace thread only)
+
+// Appends complete records to the trace file, stops at the first record still being written
+static void FlushTrace(void)
+{
+    static TraceRecord batch[64];
+    unsigned int count = 0;
+    uint32_t head = traceHead;
+    if (head - traceTail > TRACE_RING_SIZE)
+        traceTail = head - TRACE_RING_SIZE;
+
+    while ((int32_t)(head - traceTail) > 0)
+    {
+        const TraceRecord* record = &traceRing[traceTail & (TRACE_RING_SIZE-1)];
+        uint32_t number = record->number;
+        __sync_synchronize();
+        batch[count] = *record;
+        __sync_synchronize();
+        if (number != traceTail + 1 || number != record->number)
+        {
+            // Overwritten by a newer record or still being written
+            if ((int32_t)(number - (traceTail + 1)) <= 0)
+                break;
+            head = traceHead;
+            traceTail = head - TRACE_RING_SIZE;
+            continue;
+        }
+
+        traceTail++;
+        if (++count == sizeof(batch)/sizeof(batch[0]))
+        {
+            sceIoWrite(traceFile, batch, sizeof(batch));
+            count = 0;
         }
     }
+    if (count > 0)
+        sceIoWrite(traceFile, batch, count*sizeof(TraceRecord));
+}
 
-    return res;
+static int TraceThread(SceSize args, void *argp)
+{
+    while (!traceStop)
+    {
+        sceKernelDelayThread(TRACE_FLUSH_DELAY);
+        FlushTrace();
+    }
+    return 0;
 }
 
-static tai_hook_ref_t ref_hook1;
-static int hook_sceCameraClose(int devnum)
+static void StartTrace(void)
 {
-    int res = TAI_CONTINUE(int, ref_hook1, devnum);
-    
-    if ((unsigned int)devnum < NB_CAM)
+    traceBlock = sceKernelAllocMemBlock("trace_block", SCE_KERNEL_MEMBLOCK_TYPE_USER_RW, alignSizeForMemBlock(TRACE_RING_SIZE*sizeof(TraceRecord)), NULL);
+    if (traceBlock < 0)
+        return;
+    traceFile = sceIoOpen(TRACE_PATH, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0666);
+    TraceHeader header = { TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), sceKernelGetProcessTimeWide() };
+    if (traceFile < 0 || sizeof(header) != sceIoWrite(traceFile, &header, sizeof(header)))
     {
-        cameraOpened[devnum] = 0;
+        if (traceFile >= 0)
+            sceIoClose(traceFile);
+        traceFile = -1;
+        sceKernelFreeMemBlock(traceBlock);
+        traceBlock = -1;
+        return;
+    }
 
-    #ifdef ENABLE_BMP
-        width[devnum] = 0;
-        height[devnum] = 0;
-        format[devnum] = 0;
-        IBufferOnOpen[devnum] = NULL;
-        UBufferOnOpen[devnum] = NULL;
-        VBufferOnOpen[devnum] = NULL;
-    #endif
+    void* ring = NULL;
+    sceKernelGetMemBlockBase(traceBlock, &ring);
+    memset(ring, 0, TRACE_RING_SIZE*sizeof(TraceRecord));
+    traceHead = 0;
+    traceTail = 0;
+    traceStop = 0;
+    traceThread = sceKernelCreateThread("fakecamera_trace", &TraceThread, 0x10000100+16, 0x1000, 0, 0, NULL);
+    if (traceThread >= 0 && sceKernelStartThread(traceThread, 0, NULL) < 0)
+    {
+        sceKernelDeleteThread(traceThread);
+        traceThread = -1;
+    }
+    traceRing = ring;
+}
 
-        if (res < 0) res = 0;
+// Flushes remaining records, hooks must not be called anymore
+static void StopTrace(void)
+{
+    if (NULL == traceRing)
+        return;
+
+    if (traceThread >= 0)
+    {
+        traceStop = 1;
+        sceKernelWaitThreadEnd(traceThread, NULL, NULL);
+        sceKernelDeleteThread(traceThread);
+        traceThread = -1;
     }
-    
-    return res;
+    FlushTrace();
+    traceRing = NULL;
+    sceIoClose(traceFile);
+    traceFile = -1;
+    sceKernelFreeMemBlock(traceBlock);
+    traceBlock = -1;
 }
+#endif
 
-// Start - Stop
+static char titleid[16] = {'\0'};
 
-static int cameraActive[NB_CAM] = {0, 0};
-static uint64_t initTimeStamp[NB_CAM];
-static uint64_t prevTimeStamp[NB_CAM];
+#endif
+
+
+// Hooks registry
+// Every hooked SceCamera function, declared once as X(name, NID) with hook_sceCamera<name> as hook
+
+#define CAMERA_HOOKS(X) \
+    X(Open,                0xA462F801) \
+    X(Close,               0xCD6E1CFC) \
+    X(Start,               0xA8FEAE35) \
+    X(Stop,                0x1DD9C9CE) \
+    X(Read,                0x79B5C2DE) \
+    X(IsActive,            0x103A75B8) \
+    X(GetDeviceLocation,   0x274EF751) \
+    X(GetSaturation,       0x624F7653) \
+    X(SetSaturation,       0xF9F7CA3D) \
+    X(GetBrightness,       0x85D5951D) \
+    X(SetBrightness,       0x98D71588) \
+    X(GetContrast,         0x8FBE84BE) \
+    X(SetContrast,         0x6FB2900) \
+    X(GetSharpness,        0xAA72C3DC) \
+    X(SetSharpness,        0xD1A5BB0B) \
+    X(GetReverse,          0x44F6043F) \
+    X(SetReverse,          0x1175F477) \
+    X(GetEffect,           0x7E8EF3B2) \
+    X(SetEffect,           0xE9D2CFB1) \
+    X(GetEV,               0x8B5E6147) \
+    X(SetEV,               0x62AFF0B8) \
+    X(GetZoom,             0x06D3816C) \
+    X(SetZoom,             0xF7464216) \
+    X(GetAntiFlicker,      0x9FDACB99) \
+    X(SetAntiFlicker,      0xE312958A) \
+    X(GetISO,              0x4EBD5C68) \
+    X(SetISO,              0x3CF630A1) \
+    X(GetGain,             0x2C36D6F3) \
+    X(SetGain,             0xE65CFE86) \
+    X(GetWhiteBalance,     0xDBFFA1DA) \
+    X(SetWhiteBalance,     0x4D4514AC) \
+    X(GetBacklight,        0x8DD1292B) \
+    X(SetBacklight,        0xAE071044) \
+    X(GetNightmode,        0x12B6FF26) \
+    X(SetNightmode,        0x3F26233E) \
+    X(GetExposureCeiling,  0x5FA5B1BB) \
+    X(SetExposureCeiling,  0x4F34BEE) \
+    X(GetAutoControlHold,  0x06A21BBB) \
+    X(SetAutoControlHold,  0x3A0DABBD)
+
+enum
+{
+#define HOOK_INDEX(name, nid) HOOK_##name,
+    CAMERA_HOOKS(HOOK_INDEX)
+#undef HOOK_INDEX
+    NB_HOOKS
+};
+
+static SceUID g_hooks[NB_HOOKS];
+static tai_hook_ref_t hookRefs[NB_HOOKS];
+
+// Hooks statistics
+// Builds with ENABLE_HOOK_STATS count the calls of each hook and their time (including the original function) in a
+// log2 histogram, fakeCameraGetHookStats gives them to other modules
+
+#define HOOK_STATS_BUCKETS 20 // Bucket n counts calls taking from 2^(n-1) to 2^n-1 microseconds (0 for bucket 0), the last one counts longer calls too
+
+typedef struct {
+    uint32_t nid;
+    uint32_t calls;
+    uint64_t totalTime;   // Microseconds
+    uint32_t maxTime;
+    uint32_t histogram[HOOK_STATS_BUCKETS];
+} HookStats;
+
+#ifdef ENABLE_HOOK_STATS
+static HookStats hookStats[NB_HOOKS];
+#endif
+
+static inline uint64_t HookCallStart(void)
+{
+#ifdef ENABLE_HOOK_STATS
+    return sceKernelGetProcessTimeWide();
+#elif defined(ENABLE_BMP)
+    return (NULL != traceRing) ? sceKernelGetProcessTimeWide() : 0;
+#else
+    return 0;
+#endif
+}
+
+static inline void HookCallEnd(int iHook, uint64_t iStart)
+{
+#ifdef ENABLE_HOOK_STATS
+    uint64_t time = sceKernelGetProcessTimeWide() - iStart;
+    uint32_t time32 = (time > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)time;
+    int bucket = (time32 > 0) ? 32 - __builtin_clz(time32) : 0;
+    HookStats* stats = &hookStats[iHook];
+
+    __sync_fetch_and_add(&stats->calls, 1);
+    __sync_fetch_and_add(&stats->totalTime, time);
+    __sync_fetch_and_add(&stats->histogram[(bucket < HOOK_STATS_BUCKETS) ? bucket : HOOK_STATS_BUCKETS-1], 1);
+    uint32_t maxTime = stats->maxTime;
+    while (time32 > maxTime && !__sync_bool_compare_and_swap(&stats->maxTime, maxTime, time32))
+        maxTime = stats->maxTime;
+#endif
+}
+
+// Image loading statistics of each camera since it was opened, fakeCameraGetLoadStats gives them to other modules
+typedef struct {
+    uint32_t loads;       // Images loaded for the camera (BMP file, converted images cache or BMP pixels in memory)
+    uint32_t failures;    // Image loads which failed
+    uint32_t ioWaitTime;  // Microseconds spent waiting for file data by the last image load
+    uint32_t computeTime; // Microseconds spent converting pixels by the last image load
+} ImageLoadStats;
+
+// Camera buffers writes of each camera since it was opened, fakeCameraGetBlitStats gives them to other modules
+typedef struct {
+    uint32_t hits;        // Reads where buffers already held the expected frame
+    uint32_t updates;     // Reads where only a part of buffers was written
+    uint32_t rewrites;    // Reads where buffers were fully written
+    uint32_t reserved;
+    uint64_t copiedBytes; // Image bytes copied in buffers
+} BlitStats;
+
+// Open - Close
+
+#define NB_CAM 2
+
+#ifdef ENABLE_BMP
+static uint16_t width[NB_CAM] = {0, 0};
+static uint16_t height[NB_CAM] = {0, 0};
+static SceCameraFormat format[NB_CAM] = {0, 0};
+
+static void* IBufferOnOpen[NB_CAM] = {NULL, NULL};
+static void* UBufferOnOpen[NB_CAM] = {NULL, NULL};
+static void* VBufferOnOpen[NB_CAM] = {NULL, NULL};
+
+// Image state (ready: -1 no image, 0 loading, 1 loaded) is changed under imageMutex as loader threads publish images
+static ImageBuffers imageBuffers[NB_CAM] = { IMAGE_BUFFERS_INIT, IMAGE_BUFFERS_INIT };
+static SceCameraFormat imageFormat[NB_CAM] = {0, 0};
+static ImageLoadStats loadStats[NB_CAM];
+static unsigned int loadRequest[NB_CAM] = {0, 0};
+static unsigned int imageGeneration[NB_CAM] = {0, 0};
+static SceUID imageMutex = -1;
+static SceUID loaderMutex = -1; // Loader threads run one at a time
+
+// Loader threads are joined once finished (on the next image load or in module_stop), since they run module code
+// until they exit
+#define MAX_LOADER_THREADS 8
+
+static SceUID loaderThreads[MAX_LOADER_THREADS] = {-1, -1, -1, -1, -1, -1, -1, -1};
+static volatile int loaderFinished[MAX_LOADER_THREADS];
+
+// Images shared by cameras using the same BMP file: BMP pixels and their conversions to each format requested so far
+// Least recently used conversions (then BMP pixels) are freed beyond "imageMemoryLimit"
+// An image no longer used by any camera stays in memory until its slot is needed for another file
+#define NB_FORMATS (sizeof(cameraFormats)/sizeof(cameraFormats[0]))
+
+// Converted images resampled to a camera resolution ("imageScaling" setting)
+#define MAX_SCALED_IMAGES 4
+
+typedef struct {
+    ImageBuffers buffers; // ready > 0 once resampled
+    int formatIndex;
+    unsigned int width;   // Camera resolution
+    unsigned int height;
+    unsigned int lastUse;
+} ScaledImage;
 
-static tai_hook_ref_t ref_hook2;
-static int hook_sceCameraStart(int devnum)
+typedef struct {
+    char path[64];  // Resolved BMP file ('\0' for a free slot)
+    int bayerPattern; // "bayerPattern" setting of the RAW8 variant, part of the image key with the path
+    int refCount;   // Cameras using this image
+    BitmapPixels pixels;
+    ImageBuffers variants[NB_FORMATS]; // ready > 0 once converted
+    unsigned int lastUse[NB_FORMATS];
+    ScaledImage scaled[MAX_SCALED_IMAGES];
+} SharedImage;
+
+static SharedImage sharedImages[NB_CAM];
+
+// Video streams replace shared images when a video file is found
+static VideoStream videoStreams[NB_CAM];
+static int videoActive[NB_CAM] = {0, 0};
+static int cameraImage[NB_CAM] = {-1, -1}; // Shared image used by each camera
+static unsigned int imageUseClock = 0;
+
+static BlitCache blitCaches[NB_CAM];
+static BlitState blitTarget[NB_CAM] = { BLIT_STATE_INIT, BLIT_STATE_INIT }; // Last frame computed for each camera (without buffers)
+
+static void InitSharedImage(SharedImage* oImage)
 {
-    int res = TAI_CONTINUE(int, ref_hook2, devnum);
-    
-    if ((unsigned int)devnum < NB_CAM && cameraOpened[devnum])
+    BitmapPixels pixelsInit = BITMAP_PIXELS_INIT;
+    ImageBuffers buffersInit = IMAGE_BUFFERS_INIT;
+    oImage->path[0] = '\0';
+    oImage->bayerPattern = BAYER_PATTERN_RGGB;
+    oImage->refCount = 0;
+    oImage->pixels = pixelsInit;
+    for (int i = 0; i < NB_FORMATS; i++)
     {
-        cameraActive[devnum] = 1;
-        initTimeStamp[devnum] = sceKernelGetProcessTimeWide();
-        prevTimeStamp[devnum] = initTimeStamp[devnum];
-        if (res < 0) res = 0;
+        oImage->variants[i] = buffersInit;
+        oImage->lastUse[i] = 0;
+    }
+    for (int i = 0; i < MAX_SCALED_IMAGES; i++)
+    {
+        oImage->scaled[i].buffers = buffersInit;
+        oImage->scaled[i].formatIndex = -1;
+        oImage->scaled[i].lastUse = 0;
     }
-    
-    return res;
 }
 
-static tai_hook_ref_t ref_hook3;
-static int hook_sceCameraStop(int devnum)
+static void FreeSharedImage(SharedImage* ioImage)
 {
-    int res = TAI_CONTINUE(int, ref_hook3, devnum);
-    
-    if ((unsigned int)devnum < NB_CAM)
-    {
-        prevFrame[devnum] = 0;
-    #ifdef ENABLE_BMP
-        prevWidthOffset[devnum] = -1;
-        prevHeightOffset[devnum] = -1;
-        prevBuffers[devnum][0] = NULL;
-        prevBuffers[devnum][1] = NULL;
-        prevBuffers[devnum][2] = NULL;
-    #endif
+    FreeBitmapPixels(&ioImage->pixels);
+    for (int i = 0; i < NB_FORMATS; i++)
+        FreeImageBuffers(&ioImage->variants[i]);
+    for (int i = 0; i < MAX_SCALED_IMAGES; i++)
+        FreeImageBuffers(&ioImage->scaled[i].buffers);
+    InitSharedImage(ioImage);
+}
 
-        cameraActive[devnum] = 0;
-        if (res < 0) res = 0;
-    }
-    
-    return res;
+// Must be called with imageMutex locked
+static void ReleaseImage(int iDevnum)
+{
+    if (cameraImage[iDevnum] >= 0)
+        sharedImages[cameraImage[iDevnum]].refCount--;
+    cameraImage[iDevnum] = -1;
 }
 
-// Read
+static int IsSharedImageOf(const SharedImage* iImage, const char* iPath)
+{
+    return '\0' != iImage->path[0] && 0 == strcmp(iImage->path, iPath) && iImage->bayerPattern == config.bayerPattern;
+}
 
-static tai_hook_ref_t ref_hook4;
-static int hook_sceCameraRead(int devnum, SceCameraRead *pRead)
+// Must be called with imageMutex locked, the camera then uses the image of iPath (shared with the other camera when it uses the same file)
+static SharedImage* AcquireImage(int iDevnum, const char* iPath)
 {
-    int res = TAI_CONTINUE(int, ref_hook4, devnum, pRead);
-    
-    if ((unsigned int)devnum < NB_CAM && NULL != pRead && cameraActive[devnum])
-    {        
-        uint64_t newTimeStamp = sceKernelGetProcessTimeWide();
+    int current = cameraImage[iDevnum];
+    if (current >= 0 && IsSharedImageOf(&sharedImages[current], iPath))
+        return &sharedImages[current];
+    ReleaseImage(iDevnum);
 
-        if (res < 0)
+    int unused = -1;
+    for (int i = 0; i < NB_CAM; i++)
+    {
+        if (IsSharedImageOf(&sharedImages[i], iPath))
         {
-            sceKernelDelayThread(1); // Release current thread time quantum to avoid freeze in some games (Frobisher Says)
+            sharedImages[i].refCount++;
+            cameraImage[iDevnum] = i;
+            return &sharedImages[i];
+        }
+        if (0 == sharedImages[i].refCount && (unused < 0 || '\0' == sharedImages[i].path[0]))
+            unused = i;
+    }
+    if (unused < 0)
+        return NULL;
+
+    SharedImage* image = &sharedImages[unused];
+    FreeSharedImage(image);
+    strcpy(image->path, iPath);
+    image->bayerPattern = config.bayerPattern;
+    image->refCount = 1;
+    cameraImage[iDevnum] = unused;
+    return image;
+}
 
-            uint64_t fakeTimeStamp = (newTimeStamp+prevTimeStamp[devnum])>>1;
-            uint64_t fakeFrame = (((fakeTimeStamp-initTimeStamp[devnum])*framerate[devnum])>>21) + 1;
+// Image planes shown by a camera
+static int ShownImageBuffers(const ImageBuffers* iBuffers)
+{
+    for (int d = 0; d < NB_CAM; d++)
+    {
+        if (imageBuffers[d].ready > 0 && iBuffers->blockIDs[0] >= 0 && imageBuffers[d].blocksData[0] == iBuffers->blocksData[0])
+            return 1;
+    }
+    return 0;
+}
 
-            pRead->status = 0;
-            if (0 == pRead->mode)
-            {
-                // Simulate "wait next frame" time
-                while (prevFrame[devnum] >= fakeFrame)
-                {
-                    sceKernelDelayThread(1000);
-                    newTimeStamp = sceKernelGetProcessTimeWide();
-                    fakeTimeStamp = (newTimeStamp+prevTimeStamp[devnum])>>1;
-                    fakeFrame = (((fakeTimeStamp-initTimeStamp[devnum])*framerate[devnum])>>21) + 1;
-                }
-            }
-            else if (prevFrame[devnum] >= fakeFrame)
-                pRead->status = 2;
+// Must be called with imageMutex locked, variants of the formats used by cameras and images they show are kept
+static void EvictImages(SharedImage* ioImage)
+{
+    int keep[NB_CAM];
+    for (int d = 0; d < NB_CAM; d++)
+    {
+        keep[d] = -1;
+        if (cameraImage[d] >= 0 && ioImage == &sharedImages[cameraImage[d]] && imageBuffers[d].ready > 0)
+            keep[d] = FindCameraFormat(imageFormat[d]) - cameraFormats;
+    }
 
-        #ifdef ENABLE_BMP
-            ImageBuffers* imageBuf = &imageBuffers[devnum];
+    unsigned int limit = (unsigned int)config.imageMemoryLimit*1024;
+    for (;;)
+    {
+        unsigned int total = 0;
+        if (ioImage->pixels.blockID >= 0)
+            total += MemorySize(ioImage->pixels.blockID, ioImage->pixels.rowStride*ioImage->pixels.height);
 
-            char* buffers[3] = {NULL, NULL, NULL};
-            if (NULL == ((SceCameraRead2*)pRead)->unknownNullCheck && sizeof(SceCameraRead2) == pRead->size)
+        int oldest = -1;
+        for (int i = 0; i < NB_FORMATS; i++)
+        {
+            if (ioImage->variants[i].ready > 0)
             {
-                SceCameraRead2* pRead2 = (SceCameraRead2*)pRead;
-                buffers[0] = (NULL != IBufferOnOpen[devnum]) ? IBufferOnOpen[devnum] : pRead2->pIBase;
-                buffers[1] = (NULL != UBufferOnOpen[devnum]) ? UBufferOnOpen[devnum] : pRead2->pUBase;
-                buffers[2] = (NULL != VBufferOnOpen[devnum]) ? VBufferOnOpen[devnum] : pRead2->pVBase;
+                total += ImageBuffersSize(&ioImage->variants[i]);
+                int shown = 0;
+                for (int d = 0; d < NB_CAM; d++)
+                    shown |= (keep[d] == i);
+                if (!shown && (oldest < 0 || ioImage->lastUse[i] < ioImage->lastUse[oldest]))
+                    oldest = i;
             }
-            else
+        }
+        int oldestScaled = -1;
+        for (int i = 0; i < MAX_SCALED_IMAGES; i++)
+        {
+            ScaledImage* scaled = &ioImage->scaled[i];
+            if (scaled->buffers.ready > 0)
             {
-                buffers[0] = (NULL != IBufferOnOpen[devnum]) ? IBufferOnOpen[devnum] : pRead->pIBase;
-                buffers[1] = (NULL != UBufferOnOpen[devnum]) ? UBufferOnOpen[devnum] : pRead->pUBase;
-                buffers[2] = (NULL != VBufferOnOpen[devnum]) ? VBufferOnOpen[devnum] : pRead->pVBase;
+                total += ImageBuffersSize(&scaled->buffers);
+                if (!ShownImageBuffers(&scaled->buffers) && (oldestScaled < 0 || scaled->lastUse < ioImage->scaled[oldestScaled].lastUse))
+                    oldestScaled = i;
             }
-            
-            int buffersTest = (prevBuffers[devnum][0] != buffers[0] || prevBuffers[devnum][1] != buffers[1] || prevBuffers[devnum][2] != buffers[2]);
-            if (imageBuf->ready > 0 && width[devnum] > 0 && height[devnum] > 0 && (prevFrame[devnum] < fakeFrame || buffersTest))
-            {
-                prevFrame[devnum] = fakeFrame;
+        }
+        if (total <= limit)
+            return;
 
-                float widthOffsetRate = 0.f;
-                float heightOffsetRate = 0.f;
+        if (oldestScaled >= 0 && (oldest < 0 || ioImage->scaled[oldestScaled].lastUse < ioImage->lastUse[oldest]))
+        {
+            FreeImageBuffers(&ioImage->scaled[oldestScaled].buffers);
+            ioImage->scaled[oldestScaled].buffers.ready = -1;
+        }
+        else if (oldest >= 0)
+        {
+            FreeImageBuffers(&ioImage->variants[oldest]);
+            ioImage->variants[oldest].ready = -1;
+        }
+        else
+        {
+            FreeBitmapPixels(&ioImage->pixels);
+            return;
+        }
+    }
+}
 
-                signed short accel[3];
-                signed short gyro[3];
-                if (dsGetSampledAccelGyro(100, accel, gyro) >= 0)
-                {
-                    SceFVector3 accelVec = {-(float)accel[2] / 0x2000, (float)accel[0] / 0x2000, -(float)accel[1] / 0x2000};
-                    
-                    float pitch = atan2_approx(accelVec.z, -accelVec.y);
-                    float roll = atan2_approx(-accelVec.x, -accelVec.z*sign(-pitch));
+// A converted image is resampled when its size differs from the camera resolution
+static int ScalingNeeded(const ImageBuffers* iVariant, int iDevnum)
+{
+    return (IMAGE_SCALING_NONE != config.imageScaling && width[iDevnum] > 0 && height[iDevnum] > 0
+            && (iVariant->imageWidth != width[iDevnum] || iVariant->imageHeight != height[iDevnum]));
+}
 
-                    widthOffsetRate = clamp(-roll, -1.f, 1.f);
-                    heightOffsetRate = clamp(-(pitch+M_PI/2.f), -1.f, 1.f);
-                }
-                
-                unsigned int imgRowTexels = imageBuf->imageWidth;
-                unsigned int imgRowCount = imageBuf->imageHeight;
-                unsigned int bufRowTexels = width[devnum];
-                unsigned int bufRowCount = height[devnum];
-
-                unsigned int minRowTexels = (imgRowTexels < bufRowTexels) ? imgRowTexels : bufRowTexels;
-                unsigned int minRowCount = (imgRowCount < bufRowCount) ? imgRowCount : bufRowCount;
-
-                int widthLeft = imgRowTexels - bufRowTexels;
-                int heightLeft = imgRowCount - bufRowCount;
-
-                unsigned int widthOffset = (unsigned int)((1.f + widthOffsetRate) * (float)abs(widthLeft) / 2.f);
-                unsigned int heightOffset = (unsigned int)((1.f + heightOffsetRate) * (float)abs(heightLeft) / 2.f);
-                widthOffset = (widthOffset/imageBuf->widthAlign)*imageBuf->widthAlign;
-                heightOffset = (heightOffset/imageBuf->heightAlign)*imageBuf->heightAlign;
-                
-                unsigned int bufWidthOffset = 0;
-                unsigned int imgWidthOffset = 0;
-                if (widthLeft > 0)
-                    imgWidthOffset = widthOffset;
-                else
-                    bufWidthOffset = widthOffset;
-
-                unsigned int bufHeightOffset = 0;
-                unsigned int imgHeightOffset = 0;
-                if (heightLeft > 0)
-                    imgHeightOffset = heightOffset;
-                else
-                    bufHeightOffset = heightOffset;
-
-                if (prevWidthOffset[devnum] != widthOffset || prevHeightOffset[devnum] != heightOffset || buffersTest)
-                {
-                    prevWidthOffset[devnum] = widthOffset;
-                    prevHeightOffset[devnum] = heightOffset;
-                    prevBuffers[devnum][0] = buffers[0];
-                    prevBuffers[devnum][1] = buffers[1];
-                    prevBuffers[devnum][2] = buffers[2];
+// Must be called with imageMutex locked, returns the resampled image for the camera resolution if there is one
+static ScaledImage* FindScaledImage(SharedImage* iImage, int iFormatIndex, int iDevnum)
+{
+    for (int i = 0; i < MAX_SCALED_IMAGES; i++)
+    {
+        ScaledImage* scaled = &iImage->scaled[i];
+        if (scaled->buffers.ready > 0 && scaled->formatIndex == iFormatIndex && scaled->width == width[iDevnum] && scaled->height == height[iDevnum])
+            return scaled;
+    }
+    return NULL;
+}
 
-                    for (int i = 0; i < 3; i++)
-                    {
-                        char* image = (imageBuf->blockIDs[i] >= 0) ? imageBuf->blocksData[i] : NULL;
-                        if (NULL != buffers[i] && NULL != image)
-                        {
-                            unsigned int rowDepend = imageBuf->rowDepend[i];
-                            unsigned int bufOffset = bufWidthOffset + bufHeightOffset*bufRowTexels/rowDepend;
-                            unsigned int imgOffset = imgWidthOffset + imgHeightOffset*imgRowTexels/rowDepend;
-                            unsigned int texelDependBits = imageBuf->texelBits[i]*rowDepend;
-
-                            for (int row = 0; row < bufHeightOffset/rowDepend; row++)
-                                memset(buffers[i]+bitSize(row*bufRowTexels,texelDependBits), 0, bitSize(bufRowTexels,texelDependBits));
-
-                            for (int row = 0 ; row < minRowCount/rowDepend ; row++)
-                                memcpy(buffers[i]+bitSize(row*bufRowTexels+bufOffset,texelDependBits), image+bitSize(row*imgRowTexels+imgOffset,texelDependBits), bitSize(minRowTexels,texelDependBits));
-                            
-                            if (imgRowTexels < bufRowTexels)
-                            {
-                                for (int row = bufHeightOffset; row < (bufHeightOffset+minRowCount)/rowDepend ; row++)
-                                {
-                                    memset(buffers[i]+bitSize(row*bufRowTexels,texelDependBits), 0, bitSize(bufWidthOffset,texelDependBits));
-                                    memset(buffers[i]+bitSize(row*bufRowTexels+bufWidthOffset+imgRowTexels,texelDependBits), 0, bitSize(bufRowTexels-bufWidthOffset-imgRowTexels,texelDependBits));
-                                }
-                            }
-
-                            for (int row = bufHeightOffset+minRowCount; row < bufRowCount/rowDepend; row++)
-                                memset(buffers[i]+bitSize(row*bufRowTexels,texelDependBits), 0, bitSize(bufRowTexels,texelDependBits));
-                        }
-                    }
-                }
-            }
-        #endif
-            
-            pRead->frame = fakeFrame;
-            pRead->timestamp = fakeTimeStamp;
-            res = 0;
+// Must be called with imageMutex locked, frees a slot (unused or least recently used one not shown) for a new resampled image
+static ScaledImage* ReserveScaledImage(SharedImage* ioImage, int iFormatIndex, int iDevnum)
+{
+    ScaledImage* slot = NULL;
+    for (int i = 0; i < MAX_SCALED_IMAGES; i++)
+    {
+        ScaledImage* scaled = &ioImage->scaled[i];
+        if (scaled->buffers.ready <= 0)
+        {
+            slot = scaled;
+            break;
         }
-
-        prevTimeStamp[devnum] = newTimeStamp;
+        if (!ShownImageBuffers(&scaled->buffers) && (NULL == slot || scaled->lastUse < slot->lastUse))
+            slot = scaled;
     }
-
-    return res;
+    if (NULL == slot)
+        return NULL;
+
+    FreeImageBuffers(&slot->buffers);
+    slot->buffers.ready = 0;
+    slot->formatIndex = iFormatIndex;
+    slot->width = width[iDevnum];
+    slot->height = height[iDevnum];
+    return slot;
 }
 
-// Active
-
-static tai_hook_ref_t ref_hook5;
-static int hook_sceCameraIsActive(int devnum)
+// Must be called with imageMutex locked, the camera shows the image resampled to its resolution when available
+static void PublishImage(int iDevnum, SharedImage* iImage, int iFormatIndex)
 {
-    int res = TAI_CONTINUE(int, ref_hook5, devnum);
-    if ((unsigned int)devnum < NB_CAM && res <= 0) res = cameraActive[devnum];
-    return res;
+    ImageBuffers* imageBuf = &imageBuffers[iDevnum];
+    ScaledImage* scaled = ScalingNeeded(&iImage->variants[iFormatIndex], iDevnum) ? FindScaledImage(iImage, iFormatIndex, iDevnum) : NULL;
+    iImage->lastUse[iFormatIndex] = ++imageUseClock;
+    if (NULL != scaled)
+        scaled->lastUse = imageUseClock;
+    ImageBuffers published = (NULL != scaled) ? scaled->buffers : iImage->variants[iFormatIndex];
+    published.ready = 0;
+    imageBuf->ready = 0;
+    __sync_synchronize();
+    *imageBuf = published;
+    imageGeneration[iDevnum]++;
+    __sync_synchronize();
+    imageBuf->ready = 1;
 }
 
-// Location
+typedef struct {
+    int devnum;
+    SceCameraFormat format;
+    unsigned int request;
+} ImageLoadRequest;
 
-static tai_hook_ref_t ref_hook6;
-static int hook_sceCameraGetDeviceLocation(int devnum, SceFVector3 *pLocation)
+// Image file naming rules by priority (title identifier or "ALL", with or without camera name), each one with every
+// image file extension (video streams first)
+#define IMAGE_DIR "ux0:/data/FakeCamera"
+
+typedef struct {
+    int titleSpecific;
+    int cameraSpecific;
+} ImageNameRule;
+
+static const ImageNameRule imageNameRules[] = {
+    { 1, 1 }, // TITLEID00_Front / TITLEID00_Back
+    { 1, 0 }, // TITLEID00
+    { 0, 1 }, // ALL_Front / ALL_Back
+    { 0, 0 }, // ALL
+};
+
+static const char* imageExtensions[] = { ".y4m", ".yuv", ".bmp" };
+
+#define NB_IMAGE_RULES (sizeof(imageNameRules)/sizeof(imageNameRules[0]))
+#define NB_IMAGE_EXTENSIONS (sizeof(imageExtensions)/sizeof(imageExtensions[0]))
+
+// Without the "videoFiles" setting, only BMP files (last extension) are looked for
+#define IMAGE_EXTENSION_ENABLED(iExtension) (config.videoFiles || NB_IMAGE_EXTENSIONS-1 == (iExtension))
+
+static void MakeImageName(const ImageNameRule* iRule, int iDevnum, const char* iExtension, char* oName)
 {
-    int res = TAI_CONTINUE(int, ref_hook6, devnum, pLocation);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLocation && res < 0) res = 0;
-    return res;
+    sprintf(oName, "%s%s%s", iRule->titleSpecific ? titleid : "ALL", iRule->cameraSpecific ? ((1 == iDevnum) ? "_Back" : "_Front") : "", iExtension);
 }
 
-// Saturation
+#ifndef READ_WITH_KUIO
+// Image files of "ux0:data/FakeCamera" named after the rules of this title listed once, then listed again only when the
+// directory modification time changes
+// Without it (kuio can't list directories), each file name is tried with a file opening
+#define MAX_INDEXED_IMAGES 32
+
+typedef struct {
+    int valid;
+    int overflow; // Too many image files: file names are tried until the directory changes
+    SceDateTime dirTime;
+    int count;
+    char names[MAX_INDEXED_IMAGES][32];
+} ImageIndex;
 
-static int saturation[NB_CAM] = {SCE_CAMERA_SATURATION_0, SCE_CAMERA_SATURATION_0};
+static ImageIndex imageIndex;
 
-static tai_hook_ref_t ref_hook7;
-static int hook_sceCameraGetSaturation(int devnum, int *pLevel)
+static int IsImageName(const char* iName)
 {
-    int res = TAI_CONTINUE(int, ref_hook7, devnum, pLevel);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLevel && res < 0)
+    char name[32];
+    for (int r = 0; r < NB_IMAGE_RULES*NB_IMAGE_EXTENSIONS; r++)
     {
-        *pLevel = saturation[devnum];
-        res = 0;
+        for (int d = 0; d < NB_CAM; d++)
+        {
+            MakeImageName(&imageNameRules[r/NB_IMAGE_EXTENSIONS], d, imageExtensions[r%NB_IMAGE_EXTENSIONS], name);
+            if (SameNameNoCase(iName, name))
+                return 1;
+        }
     }
-    return res;
+    return 0;
 }
 
-static tai_hook_ref_t ref_hook8;
-static int hook_sceCameraSetSaturation(int devnum, int level)
+// Returns 0 when the index can't be used
+static int UpdateImageIndex()
 {
-    int res = TAI_CONTINUE(int, ref_hook8, devnum, level);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    SceIoStat stat;
+    if (sceIoGetstat(IMAGE_DIR, &stat) < 0)
+        return 0;
+    if (imageIndex.valid && 0 == memcmp(&imageIndex.dirTime, &stat.st_mtime, sizeof(SceDateTime)))
+        return !imageIndex.overflow;
+
+    SceUID dfd = sceIoDopen(IMAGE_DIR);
+    if (dfd < 0)
+        return 0;
+
+    SceIoDirent entry;
+    imageIndex.valid = 1;
+    imageIndex.overflow = 0;
+    imageIndex.dirTime = stat.st_mtime;
+    imageIndex.count = 0;
+    while (sceIoDread(dfd, &entry) > 0)
     {
-        saturation[devnum] = level;
-        res = 0;
+        // Images of other titles are left out
+        if (!IsImageName(entry.d_name))
+            continue;
+        if (imageIndex.count >= MAX_INDEXED_IMAGES)
+        {
+            imageIndex.overflow = 1;
+            break;
+        }
+        strcpy(imageIndex.names[imageIndex.count++], entry.d_name);
     }
-    return res;
+    sceIoDclose(dfd);
+    return !imageIndex.overflow;
 }
+#endif
 
-// Brightness
+static SceUID OpenImageFile(int iDevnum, char* oPath)
+{
+    char name[32];
+#ifndef READ_WITH_KUIO
+    if (UpdateImageIndex())
+    {
+        int stale = 0;
+        for (int r = 0; r < NB_IMAGE_RULES*NB_IMAGE_EXTENSIONS && !stale; r++)
+        {
+            if (!IMAGE_EXTENSION_ENABLED(r%NB_IMAGE_EXTENSIONS))
+                continue;
+            MakeImageName(&imageNameRules[r/NB_IMAGE_EXTENSIONS], iDevnum, imageExtensions[r%NB_IMAGE_EXTENSIONS], name);
+            for (int i = 0; i < imageIndex.count && !stale; i++)
+            {
+                if (SameNameNoCase(imageIndex.names[i], name))
+                {
+                    sprintf(oPath, IMAGE_DIR "/%s", imageIndex.names[i]);
+                    SceUID fd = OpenFile(oPath);
+                    if (fd >= 0)
+                        return fd;
+                    stale = 1;
+                }
+            }
+        }
+        if (!stale)
+            return -1;
+        // The directory changed without its modification time (or the file can't be opened): names are tried instead
+        imageIndex.valid = 0;
+    }
+#endif
 
-static int brightness[NB_CAM] = {127, 127};
+    // Each missing file costs a file opening (kuio), up to 12 of them with video files or 4 without them
+    for (int r = 0; r < NB_IMAGE_RULES*NB_IMAGE_EXTENSIONS; r++)
+    {
+        if (!IMAGE_EXTENSION_ENABLED(r%NB_IMAGE_EXTENSIONS))
+            continue;
+        MakeImageName(&imageNameRules[r/NB_IMAGE_EXTENSIONS], iDevnum, imageExtensions[r%NB_IMAGE_EXTENSIONS], name);
+        sprintf(oPath, IMAGE_DIR "/%s", name);
+        SceUID fd = OpenFile(oPath);
+        if (fd >= 0)
+            return fd;
+    }
+    return -1;
+}
 
-static tai_hook_ref_t ref_hook9;
-static int hook_sceCameraGetBrightness(int devnum, int *pLevel)
+// Must be called with imageMutex locked
+static void StopCameraVideo(int iDevnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook9, devnum, pLevel);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLevel && res < 0)
+    if (videoActive[iDevnum])
     {
-        *pLevel = brightness[devnum];
-        res = 0;
+        videoActive[iDevnum] = 0;
+        StopVideoStream(&videoStreams[iDevnum]);
     }
-    return res;
 }
 
-static tai_hook_ref_t ref_hook10;
-static int hook_sceCameraSetBrightness(int devnum, int level)
+// The video stream replaces the camera image if the camera hasn't been reopened meanwhile
+static void ProcessVideoLoad(const ImageLoadRequest* iRequest, SceUID iFile, const char* iPath)
 {
-    int res = TAI_CONTINUE(int, ref_hook10, devnum, level);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    int devnum = iRequest->devnum;
+    VideoStream* stream = &videoStreams[devnum];
+    char memname[48];
+    snprintf(memname, sizeof(memname), "%s_%s_video", titleid, (1 == devnum)?"Back":"Front");
+    //LOG("Try to stream file %s\n", iPath);
+    int res = StartVideoStream(stream, iFile, iPath, iRequest->format, memname);
+
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    if (iRequest->request == loadRequest[devnum])
     {
-        brightness[devnum] = level;
-        res = 0;
+        if (res >= 0)
+        {
+            ReleaseImage(devnum);
+            videoActive[devnum] = 1;
+            imageBuffers[devnum] = stream->frames[0];
+            imageBuffers[devnum].ready = 0;
+            imageGeneration[devnum]++;
+            __sync_synchronize();
+            imageBuffers[devnum].ready = 1;
+        }
+        else
+        {
+            imageFormat[devnum] = SCE_CAMERA_FORMAT_INVALID;
+            imageBuffers[devnum].ready = -1;
+        }
     }
-    return res;
+    else if (res >= 0)
+        StopVideoStream(stream);
+    sceKernelUnlockMutex(imageMutex, 1);
 }
 
-// Contrast
+// Converts the image from BMP pixels in memory when possible, otherwise loads it from file
+// Loaders run one at a time, so a file used by both cameras is only decoded once
+// The result is kept in the shared image even when the camera has been reopened with another format meanwhile
+static void ProcessImageLoad(const ImageLoadRequest* iRequest)
+{
+    int devnum = iRequest->devnum;
+    const CameraFormatDesc* desc = FindCameraFormat(iRequest->format);
+    char pathname[64];
+    SceUID fd = -1;
+
+    sceKernelLockMutex(loaderMutex, 1, NULL);
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    int pending = (iRequest->request == loadRequest[devnum]);
+    sceKernelUnlockMutex(imageMutex, 1);
+    if (pending && NULL != desc)
+        fd = OpenImageFile(devnum, pathname);
+    if (fd >= 0 && !HasExtension(pathname, ".bmp"))
+    {
+        ProcessVideoLoad(iRequest, fd, pathname);
+        sceKernelUnlockMutex(loaderMutex, 1);
+        return;
+    }
+
+    SharedImage* image = NULL;
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    if (fd >= 0 && iRequest->request == loadRequest[devnum])
+        image = AcquireImage(devnum, pathname);
+    sceKernelUnlockMutex(imageMutex, 1);
 
-static int contrast[NB_CAM] = {127, 127};
+    int res = -1;
+    LoadStats stats = {0, 0};
+    uint64_t loadStart = sceKernelGetProcessTimeWide();
+    if (NULL != image)
+    {
+        ImageBuffers* variant = &image->variants[desc - cameraFormats];
+        if (variant->ready > 0)
+            res = 1;
+        else
+        {
+            char memname[48];
+            snprintf(memname, sizeof(memname), "%s_%d_%d", titleid, (int)(image - sharedImages), iRequest->format);
+            //LOG("Try to load file %s\n", pathname);
+            if (NULL != image->pixels.data)
+                res = ConvertBitmap(&image->pixels, iRequest->format, memname, variant, &stats);
+            else
+                res = LoadBMPFile(fd, pathname, iRequest->format, memname, &image->pixels, variant, &stats);
+            if (res < 0)
+                FreeImageBuffers(variant);
+            TraceEvent(TRACE_IMAGE_LOAD, devnum, loadStart, 0, (res >= 0) ? ImageBuffersSize(variant) : 0, res);
+        }
+    }
+    if (fd >= 0)
+        CloseFile(fd);
 
-static tai_hook_ref_t ref_hook11;
-static int hook_sceCameraGetContrast(int devnum, int *pLevel)
-{
-    int res = TAI_CONTINUE(int, ref_hook11, devnum, pLevel);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLevel && res < 0)
+    // Copy resampled to the camera resolution (the image is shown as is if it fails)
+    ScaledImage* scaled = NULL;
+    if (res >= 0 && ScalingNeeded(&image->variants[desc - cameraFormats], devnum))
     {
-        *pLevel = contrast[devnum];
-        res = 0;
+        sceKernelLockMutex(imageMutex, 1, NULL);
+        if (NULL == FindScaledImage(image, desc - cameraFormats, devnum))
+            scaled = ReserveScaledImage(image, desc - cameraFormats, devnum);
+        sceKernelUnlockMutex(imageMutex, 1);
+
+        if (NULL != scaled)
+        {
+            char memname[48];
+            snprintf(memname, sizeof(memname), "%s_%d_%d_s%d", titleid, (int)(image - sharedImages), iRequest->format, (int)(scaled - image->scaled));
+            if (ScaleImage(&image->variants[desc - cameraFormats], desc, scaled->width, scaled->height, memname, &scaled->buffers) < 0)
+            {
+                FreeImageBuffers(&scaled->buffers);
+                scaled->buffers.ready = -1;
+                scaled = NULL;
+            }
+        }
     }
-    return res;
-}
 
-static tai_hook_ref_t ref_hook12;
-static int hook_sceCameraSetContrast(int devnum, int level)
-{
-    int res = TAI_CONTINUE(int, ref_hook12, devnum, level);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    if (res >= 0)
+    {
+        image->variants[desc - cameraFormats].ready = 1;
+        if (NULL != scaled)
+            scaled->buffers.ready = 1;
+        if (iRequest->request == loadRequest[devnum])
+        {
+            loadStats[devnum].loads++;
+            loadStats[devnum].ioWaitTime = stats.ioWaitTime;
+            loadStats[devnum].computeTime = stats.computeTime;
+            PublishImage(devnum, image, desc - cameraFormats);
+            //LOG(" => Success (I/O wait %u us, compute %u us)\n", stats.ioWaitTime, stats.computeTime);
+        }
+        EvictImages(image);
+    }
+    else if (pending && iRequest->request == loadRequest[devnum])
     {
-        contrast[devnum] = level;
-        res = 0;
+        imageFormat[devnum] = SCE_CAMERA_FORMAT_INVALID;
+        imageBuffers[devnum].ready = -1;
+        loadStats[devnum].failures++;
+        //LOG(" => Failed\n");
     }
-    return res;
+    sceKernelUnlockMutex(imageMutex, 1);
+    sceKernelUnlockMutex(loaderMutex, 1);
+    //log_flush();
 }
 
-// Sharpness
+typedef struct {
+    ImageLoadRequest request;
+    int slot; // Index in loaderThreads
+} LoaderThreadArgs;
 
-static int sharpness[NB_CAM] = {SCE_CAMERA_SHARPNESS_100, SCE_CAMERA_SHARPNESS_100};
+static int ImageLoaderThread(SceSize args, void *argp)
+{
+    const LoaderThreadArgs* loader = (const LoaderThreadArgs*)argp;
+    ProcessImageLoad(&loader->request);
+    loaderFinished[loader->slot] = 1;
+    return 0;
+}
 
-static tai_hook_ref_t ref_hook13;
-static int hook_sceCameraGetSharpness(int devnum, int *pLevel)
+// Must be called with imageMutex locked (or from module_stop), waits for the end of every loader thread when iAll is set
+static void JoinLoaderThreads(int iAll)
 {
-    int res = TAI_CONTINUE(int, ref_hook13, devnum, pLevel);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLevel && res < 0)
+    for (int i = 0; i < MAX_LOADER_THREADS; i++)
     {
-        *pLevel = sharpness[devnum];
-        res = 0;
+        if (loaderThreads[i] >= 0 && (iAll || loaderFinished[i]))
+        {
+            sceKernelWaitThreadEnd(loaderThreads[i], NULL, NULL);
+            sceKernelDeleteThread(loaderThreads[i]);
+            loaderThreads[i] = -1;
+        }
     }
-    return res;
 }
 
-static tai_hook_ref_t ref_hook14;
-static int hook_sceCameraSetSharpness(int devnum, int level)
+// Must be called with imageMutex locked, the image is loaded in background (or immediately if no thread can be created)
+static void StartImageLoad(int iDevnum, SceCameraFormat iFormat)
 {
-    int res = TAI_CONTINUE(int, ref_hook14, devnum, level);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    imageBuffers[iDevnum].ready = 0;
+    StopCameraVideo(iDevnum);
+    imageFormat[iDevnum] = iFormat;
+    ImageLoadRequest request = { iDevnum, iFormat, ++loadRequest[iDevnum] };
+
+    // Already converted images are shown at once
+    const CameraFormatDesc* desc = FindCameraFormat(iFormat);
+    SharedImage* image = (cameraImage[iDevnum] >= 0) ? &sharedImages[cameraImage[iDevnum]] : NULL;
+    if (NULL != desc && NULL != image && image->variants[desc - cameraFormats].ready > 0
+        && (!ScalingNeeded(&image->variants[desc - cameraFormats], iDevnum) || NULL != FindScaledImage(image, desc - cameraFormats, iDevnum)))
     {
-        sharpness[devnum] = level;
-        res = 0;
+        PublishImage(iDevnum, image, desc - cameraFormats);
+        return;
     }
-    return res;
+
+    JoinLoaderThreads(0);
+    LoaderThreadArgs loader = { request, 0 };
+    while (loader.slot < MAX_LOADER_THREADS && loaderThreads[loader.slot] >= 0)
+        loader.slot++;
+    if (loader.slot < MAX_LOADER_THREADS)
+    {
+        SceUID threadID = sceKernelCreateThread("fakecamera_loader", &ImageLoaderThread, 0x10000100, 0x4000, 0, 0, NULL);
+        loaderFinished[loader.slot] = 0;
+        if (threadID >= 0 && sceKernelStartThread(threadID, sizeof(loader), &loader) >= 0)
+        {
+            loaderThreads[loader.slot] = threadID;
+            return;
+        }
+        if (threadID >= 0)
+            sceKernelDeleteThread(threadID);
+    }
+
+    sceKernelUnlockMutex(imageMutex, 1);
+    ProcessImageLoad(&request);
+    sceKernelLockMutex(imageMutex, 1, NULL);
 }
+#endif
+
+static int cameraOpened[NB_CAM] = {0, 0};
+static uint16_t framerate[NB_CAM];
+static uint64_t prevFrame[NB_CAM] = {0, 0};
+static int cameraActive[NB_CAM] = {0, 0};
+static uint64_t initTimeStamp[NB_CAM];
+static uint64_t prevTimeStamp[NB_CAM];
+
+#ifdef ENABLE_BMP
+#define readYieldPolicy config.readYield
+#define readPacingEnabled config.readPacing
+#else
+#define readYieldPolicy READ_YIELD_ALWAYS
+#define readPacingEnabled 0
+#endif
 
-// Reverse
+// Camera frame clock
+// Frames are counted from 1 at camera start and frame n starts exactly n-1 frame periods later (rational arithmetic on
+// microseconds, SCE_CAMERA_FRAMERATE_7_FPS standing for 7.5 frames per second)
+// Camera time comes from a time source: process time, or a virtual time advanced by exactly one frame period on each
+// camera read, which gives reproducible frame numbers and time stamps ("virtualClock" setting, also usable by host tests)
 
-static int reverse[NB_CAM] = {SCE_CAMERA_REVERSE_OFF, SCE_CAMERA_REVERSE_OFF};
+typedef struct {
+    uint64_t (*now)(int devnum);
+    uint64_t (*readTime)(int devnum);                   // Time of a new camera read
+    uint64_t (*waitUntil)(int devnum, uint64_t iTime); // Returns the time once iTime is reached
+} TimeSource;
 
-static tai_hook_ref_t ref_hook15;
-static int hook_sceCameraGetReverse(int devnum, int *pMode)
+static uint64_t ProcessTimeNow(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook15, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = reverse[devnum];
-        res = 0;
-    }
-    return res;
+    return sceKernelGetProcessTimeWide();
 }
 
-static tai_hook_ref_t ref_hook16;
-static int hook_sceCameraSetReverse(int devnum, int mode)
+static uint64_t ProcessTimeWaitUntil(int devnum, uint64_t iTime)
 {
-    int res = TAI_CONTINUE(int, ref_hook16, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    uint64_t now = sceKernelGetProcessTimeWide();
+    while (now < iTime)
     {
-        reverse[devnum] = mode;
-        res = 0;
+        sceKernelDelayThread((iTime-now > 1000000) ? 1000000 : iTime-now);
+        now = sceKernelGetProcessTimeWide();
     }
-    return res;
+    return now;
 }
 
-// Effect
+static const TimeSource processTimeSource = { &ProcessTimeNow, &ProcessTimeNow, &ProcessTimeWaitUntil };
+static const TimeSource* timeSource = &processTimeSource;
 
-static int effect[NB_CAM] = {SCE_CAMERA_EFFECT_NORMAL, SCE_CAMERA_EFFECT_NORMAL};
+static inline void FrameRateRatio(int devnum, uint64_t* oNum, uint64_t* oDen)
+{
+    *oNum = (SCE_CAMERA_FRAMERATE_7_FPS == framerate[devnum]) ? 15 : framerate[devnum];
+    *oDen = (SCE_CAMERA_FRAMERATE_7_FPS == framerate[devnum]) ? 2 : 1;
+}
 
-static tai_hook_ref_t ref_hook17;
-static int hook_sceCameraGetEffect(int devnum, int *pMode)
+static inline uint64_t FrameAt(int devnum, uint64_t iTime)
 {
-    int res = TAI_CONTINUE(int, ref_hook17, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = effect[devnum];
-        res = 0;
-    }
-    return res;
+    uint64_t num, den;
+    FrameRateRatio(devnum, &num, &den);
+    return ((iTime-initTimeStamp[devnum])*num)/(1000000*den) + 1;
 }
 
-static tai_hook_ref_t ref_hook18;
-static int hook_sceCameraSetEffect(int devnum, int mode)
+// First time of frame iFrame (framerate must not be 0)
+static inline uint64_t FrameStart(int devnum, uint64_t iFrame)
 {
-    int res = TAI_CONTINUE(int, ref_hook18, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
-    {
-        effect[devnum] = mode;
-        res = 0;
-    }
-    return res;
+    uint64_t num, den;
+    FrameRateRatio(devnum, &num, &den);
+    return initTimeStamp[devnum] + ((iFrame-1)*1000000*den + num - 1)/num;
+}
+
+#ifdef ENABLE_BMP
+static uint64_t virtualTime[NB_CAM];
+static uint64_t virtualFrame[NB_CAM]; // Frame started at virtualTime
+
+static uint64_t VirtualTimeNow(int devnum)
+{
+    return virtualTime[devnum];
+}
+
+static uint64_t VirtualTimeRead(int devnum)
+{
+    if (framerate[devnum] > 0)
+        virtualTime[devnum] = FrameStart(devnum, ++virtualFrame[devnum]);
+    return virtualTime[devnum];
 }
 
-// EV
+static uint64_t VirtualTimeWaitUntil(int devnum, uint64_t iTime)
+{
+    if (virtualTime[devnum] < iTime)
+        virtualTime[devnum] = iTime;
+    return virtualTime[devnum];
+}
+
+static const TimeSource virtualTimeSource = { &VirtualTimeNow, &VirtualTimeRead, &VirtualTimeWaitUntil };
+#endif
 
-static int ev[NB_CAM] = {SCE_CAMERA_EV_POSITIVE_0, SCE_CAMERA_EV_POSITIVE_0};
+#ifdef ENABLE_BMP
+// Frames rendering
 
-static tai_hook_ref_t ref_hook19;
-static int hook_sceCameraGetEV(int devnum, int *pLevel)
+// Updates ioTarget with the frame shown by a camera at iFrame: image window scrolled with motion controls, or black frame while the image is loading
+// Returns 1 for an image frame, 0 for a black frame and -1 when there is nothing to show, *oImage is the image to copy in camera buffers
+static int PrepareFrame(int devnum, uint64_t iFrame, int iNewFrame, BlitState* ioTarget, const ImageBuffers** oImage)
 {
-    int res = TAI_CONTINUE(int, ref_hook19, devnum, pLevel);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLevel && res < 0)
+    const ImageBuffers* imageBuf = &imageBuffers[devnum];
+    int imageReady = imageBuf->ready;
+    __sync_synchronize();
+    int generation = imageGeneration[devnum];
+    unsigned int videoFrame = 0;
+    if (imageReady > 0 && videoActive[devnum])
     {
-        *pLevel = ev[devnum];
-        res = 0;
+        VideoStream* stream = &videoStreams[devnum];
+        uint64_t rateNum, rateDen;
+        FrameRateRatio(devnum, &rateNum, &rateDen);
+        videoFrame = NextVideoFrame(stream, iFrame, rateNum, rateDen);
+        imageBuf = &stream->frames[videoFrame % stream->ringSize];
     }
-    return res;
+    int generationTest = (ioTarget->generation != generation || ioTarget->videoFrame != videoFrame);
+    if (imageReady > 0 && width[devnum] > 0 && height[devnum] > 0 && (iNewFrame || generationTest))
+    {
+        float widthOffsetRate = 0.f;
+        float heightOffsetRate = 0.f;
+        if (GetMotionRates(&widthOffsetRate, &heightOffsetRate) < 0)
+        {
+            widthOffsetRate = 0.f;
+            heightOffsetRate = 0.f;
+        }
+
+        unsigned int imgRowTexels = imageBuf->imageWidth;
+        unsigned int imgRowCount = imageBuf->imageHeight;
+        unsigned int bufRowTexels = width[devnum];
+        unsigned int bufRowCount = height[devnum];
+
+        unsigned int minRowTexels = (imgRowTexels < bufRowTexels) ? imgRowTexels : bufRowTexels;
+        unsigned int minRowCount = (imgRowCount < bufRowCount) ? imgRowCount : bufRowCount;
+
+        int widthLeft = imgRowTexels - bufRowTexels;
+        int heightLeft = imgRowCount - bufRowCount;
+
+        unsigned int widthOffset = (unsigned int)((1.f + widthOffsetRate) * (float)abs(widthLeft) / 2.f);
+        unsigned int heightOffset = (unsigned int)((1.f + heightOffsetRate) * (float)abs(heightLeft) / 2.f);
+        widthOffset = (widthOffset/imageBuf->widthAlign)*imageBuf->widthAlign;
+        heightOffset = (heightOffset/imageBuf->heightAlign)*imageBuf->heightAlign;
+        
+        unsigned int bufWidthOffset = 0;
+        unsigned int imgWidthOffset = 0;
+        if (widthLeft > 0)
+            imgWidthOffset = widthOffset;
+        else
+            bufWidthOffset = widthOffset;
+
+        unsigned int bufHeightOffset = 0;
+        unsigned int imgHeightOffset = 0;
+        if (heightLeft > 0)
+            imgHeightOffset = heightOffset;
+        else
+            bufHeightOffset = heightOffset;
+
+        BlitState frameTarget = { {NULL, NULL, NULL}, FindCameraFormat(format[devnum]), bufRowTexels, bufRowCount, generation, videoFrame,
+                                  imgWidthOffset, imgHeightOffset, bufWidthOffset, bufHeightOffset, minRowTexels, minRowCount };
+        *ioTarget = frameTarget;
+    }
+    else if (0 == imageReady && width[devnum] > 0 && height[devnum] > 0 && 0 != ioTarget->generation)
+    {
+        // Black placeholder frame until the image is loaded
+        BlitState blackTarget = { {NULL, NULL, NULL}, FindCameraFormat(format[devnum]), width[devnum], height[devnum], 0, 0, 0, 0, 0, 0, 0, 0 };
+        *ioTarget = blackTarget;
+    }
+
+    *oImage = (ioTarget->generation > 0) ? imageBuf : NULL;
+    if (imageReady < 0 || ioTarget->generation < 0)
+        return -1;
+    return (ioTarget->generation > 0) ? 1 : 0;
 }
 
-static tai_hook_ref_t ref_hook20;
-static int hook_sceCameraSetEV(int devnum, int level)
+// Optional frame producer: a helper thread renders each camera frame at the camera frame rate in staging buffers (triple buffering),
+// reads only copy the latest rendered frame in camera buffers
+#define NB_PRODUCER_FRAMES 3
+#define PRODUCER_FRAME_NEW 0x4 // Set in "middle" until a read takes the frame
+
+typedef struct {
+    ImageBuffers frames[NB_PRODUCER_FRAMES];
+    BlitState frameStates[NB_PRODUCER_FRAMES]; // Content of each staging frame
+    unsigned int frameIDs[NB_PRODUCER_FRAMES]; // Unique rendering number of each staging frame (0 before the first one)
+    int frameImages[NB_PRODUCER_FRAMES];       // 1 for an image frame, 0 for a black frame
+    unsigned int renderCount;
+    int front;           // Frame copied by reads
+    int back;            // Frame rendered by the producer
+    volatile int middle; // Latest rendered frame
+    volatile int stop;
+    SceUID thread;
+} FrameProducer;
+
+static FrameProducer producers[NB_CAM];
+static int producerActive[NB_CAM] = {0, 0};
+
+static int FrameProducerThread(SceSize args, void *argp)
 {
-    int res = TAI_CONTINUE(int, ref_hook20, devnum, level);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    int devnum = *(int*)argp;
+    FrameProducer* producer = &producers[devnum];
+    BlitState target = BLIT_STATE_INIT;
+    BlitState published = BLIT_STATE_INIT;
+    uint64_t frame = 0;
+
+    while (!producer->stop)
     {
-        ev[devnum] = level;
-        res = 0;
+        uint64_t newFrame = FrameAt(devnum, timeSource->now(devnum));
+        const ImageBuffers* image = NULL;
+        int shown = PrepareFrame(devnum, newFrame, (frame < newFrame), &target, &image);
+        frame = newFrame;
+
+        // Frames are only rendered when their content changes
+        if (shown >= 0 && (published.generation < 0 || !SameBlitContent(&target, &published)))
+        {
+            int back = producer->back;
+            ImageBuffers* staging = &producer->frames[back];
+            BlitState stagingTarget = target;
+            for (int i = 0; i < 3; i++)
+                stagingTarget.buffers[i] = (staging->blockIDs[i] >= 0) ? staging->blocksData[i] : NULL;
+
+            BlitImage(&producer->frameStates[back], &stagingTarget, image, NULL);
+            producer->frameIDs[back] = ++producer->renderCount;
+            producer->frameImages[back] = shown;
+            published = target;
+
+            __sync_synchronize();
+            producer->back = __sync_lock_test_and_set(&producer->middle, back | PRODUCER_FRAME_NEW) & ~PRODUCER_FRAME_NEW;
+        }
+
+        // Sleep until the next frame (at least 1 ms, at most 100 ms to check stop requests)
+        uint64_t delay = 100000;
+        if (framerate[devnum] > 0)
+        {
+            uint64_t nextTime = FrameStart(devnum, frame+1);
+            uint64_t now = timeSource->now(devnum);
+            delay = (nextTime > now) ? nextTime-now : 0;
+        }
+        sceKernelDelayThread(clamp(delay, 1000, 100000));
     }
-    return res;
+    return 0;
 }
 
-// Zoom
-
-static int zoom[NB_CAM] = {10, 10};
-
-static tai_hook_ref_t ref_hook21;
-static int hook_sceCameraGetZoom(int devnum, int *pLevel)
+static void StopFrameProducer(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook21, devnum, pLevel);
-    if ((unsigned int)devnum < NB_CAM && NULL != pLevel && res < 0)
+    FrameProducer* producer = &producers[devnum];
+    if (producer->thread >= 0)
     {
-        *pLevel = zoom[devnum];
-        res = 0;
+        producer->stop = 1;
+        sceKernelWaitThreadEnd(producer->thread, NULL, NULL);
+        sceKernelDeleteThread(producer->thread);
+        producer->thread = -1;
     }
-    return res;
+    for (int i = 0; i < NB_PRODUCER_FRAMES; i++)
+        FreeImageBuffers(&producer->frames[i]);
+    producerActive[devnum] = 0;
 }
 
-static tai_hook_ref_t ref_hook22;
-static int hook_sceCameraSetZoom(int devnum, int level)
+// Staging frames have the size and format of camera buffers, reads fall back to rendering frames themselves when they can't be allocated
+static void StartFrameProducer(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook22, devnum, level);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    FrameProducer* producer = &producers[devnum];
+    const CameraFormatDesc* desc = FindCameraFormat(format[devnum]);
+    if (!config.frameProducer || NULL == desc || width[devnum] <= 0 || height[devnum] <= 0)
+        return;
+
+    char memname[32];
+    ImageBuffers buffersInit = IMAGE_BUFFERS_INIT;
+    BlitState stateInit = BLIT_STATE_INIT;
+    for (int i = 0; i < NB_PRODUCER_FRAMES; i++)
     {
-        zoom[devnum] = level;
-        res = 0;
+        producer->frames[i] = buffersInit;
+        producer->frameStates[i] = stateInit;
+        producer->frameIDs[i] = 0;
+        producer->frameImages[i] = 0;
+    }
+    producer->renderCount = 0;
+    producer->front = 0;
+    producer->middle = 1;
+    producer->back = 2;
+    producer->stop = 0;
+    producer->thread = -1;
+
+    for (int i = 0; i < NB_PRODUCER_FRAMES; i++)
+    {
+        snprintf(memname, sizeof(memname), "fakecamera_frame%d_%d", devnum, i);
+        SetImageGeometry(desc, width[devnum], height[devnum], &producer->frames[i]);
+        if (AllocImageBuffers(memname, &producer->frames[i]) < 0)
+        {
+            StopFrameProducer(devnum);
+            return;
+        }
     }
-    return res;
-}
-
-// AntiFlicker
-
-static int antiFlicker[NB_CAM] = {SCE_CAMERA_ANTIFLICKER_AUTO, SCE_CAMERA_ANTIFLICKER_AUTO};
 
-static tai_hook_ref_t ref_hook23;
-static int hook_sceCameraGetAntiFlicker(int devnum, int *pMode)
-{
-    int res = TAI_CONTINUE(int, ref_hook23, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
+    int devArg = devnum;
+    producer->thread = sceKernelCreateThread("fakecamera_producer", &FrameProducerThread, 0x10000100, 0x2000, 0, 0, NULL);
+    if (producer->thread < 0 || sceKernelStartThread(producer->thread, sizeof(devArg), &devArg) < 0)
     {
-        *pMode = antiFlicker[devnum];
-        res = 0;
+        if (producer->thread >= 0)
+            sceKernelDeleteThread(producer->thread);
+        producer->thread = -1;
+        StopFrameProducer(devnum);
+        return;
     }
-    return res;
+    producerActive[devnum] = 1;
 }
+#endif
 
-static tai_hook_ref_t ref_hook24;
-static int hook_sceCameraSetAntiFlicker(int devnum, int mode)
+static int hook_sceCameraOpen(int devnum, SceCameraInfo *pInfo)
 {
-    int res = TAI_CONTINUE(int, ref_hook24, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Open], devnum, pInfo);
+    
+    if ((unsigned int)devnum < NB_CAM && NULL != pInfo && !cameraOpened[devnum])
     {
-        antiFlicker[devnum] = mode;
-        res = 0;
-    }
-    return res;
-}
+        cameraOpened[devnum] = 1;
+        framerate[devnum] = pInfo->framerate;
 
-// ISO
+        if (res < 0 && pInfo->resolution > SCE_CAMERA_RESOLUTION_0_0 && pInfo->resolution <= SCE_CAMERA_RESOLUTION_640_360)
+        {
+            if (pInfo->resolution < SCE_CAMERA_RESOLUTION_352_288)
+            {
+                pInfo->width = (640 >> (pInfo->resolution-1));
+                pInfo->height = (480 >> (pInfo->resolution-1));
+            }
+            else if (pInfo->resolution < SCE_CAMERA_RESOLUTION_480_272)
+            {
+                pInfo->width = (352 >> (pInfo->resolution-4));
+                pInfo->height = (288 >> (pInfo->resolution-4));
+            }
+            else if (SCE_CAMERA_RESOLUTION_480_272 == pInfo->resolution)
+            {
+                pInfo->width = 480;
+                pInfo->height = 272;
+            }
+            else if (SCE_CAMERA_RESOLUTION_640_360 == pInfo->resolution)
+            {
+                pInfo->width = 640;
+                pInfo->height = 360;
+            }
+        
+        #ifdef ENABLE_BMP
+            width[devnum] = pInfo->width;
+            height[devnum] = pInfo->height;
+            if (0 == pInfo->buffer)
+            {
+                IBufferOnOpen[devnum] = pInfo->pIBase;
+                UBufferOnOpen[devnum] = pInfo->pUBase;
+                VBufferOnOpen[devnum] = pInfo->pVBase;
+            }
+            format[devnum] = pInfo->format;
+            
+            //LOG("Camera opened %d with format %d\n", devnum, pInfo->format);
+            //LOG("Buffers pointers %x, %x, %x\n", (unsigned int)pInfo->pIBase, (unsigned int)pInfo->pUBase, (unsigned int)pInfo->pVBase);
+            //log_flush();
 
-static int iso[NB_CAM] = {SCE_CAMERA_ISO_AUTO, SCE_CAMERA_ISO_AUTO};
+            sceKernelLockMutex(imageMutex, 1, NULL);
+            memset(&loadStats[devnum], 0, sizeof(ImageLoadStats));
+            blitCaches[devnum].hits = 0;
+            blitCaches[devnum].updates = 0;
+            blitCaches[devnum].rewrites = 0;
+            blitCaches[devnum].copiedBytes = 0;
+            if (imageBuffers[devnum].ready < 0 || imageFormat[devnum] != pInfo->format)
+                StartImageLoad(devnum, pInfo->format);
+            sceKernelUnlockMutex(imageMutex, 1);
+        #endif
 
-static tai_hook_ref_t ref_hook25;
-static int hook_sceCameraGetISO(int devnum, int *pMode)
-{
-    int res = TAI_CONTINUE(int, ref_hook25, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = iso[devnum];
-        res = 0;
+            res = 0;
+        }
     }
+
+    HookCallEnd(HOOK_Open, hookStart);
+#ifdef ENABLE_BMP
+    if ((unsigned int)devnum < NB_CAM)
+        TraceEvent(TRACE_OPEN, devnum, hookStart, 0, 0, res);
+#endif
     return res;
 }
 
-static tai_hook_ref_t ref_hook26;
-static int hook_sceCameraSetISO(int devnum, int mode)
+static int hook_sceCameraClose(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook26, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Close], devnum);
+    
+    if ((unsigned int)devnum < NB_CAM)
     {
-        iso[devnum] = mode;
-        res = 0;
-    }
-    return res;
-}
+        cameraOpened[devnum] = 0;
 
-// Gain
+    #ifdef ENABLE_BMP
+        if (producerActive[devnum])
+            StopFrameProducer(devnum);
+        width[devnum] = 0;
+        height[devnum] = 0;
+        format[devnum] = 0;
+        IBufferOnOpen[devnum] = NULL;
+        UBufferOnOpen[devnum] = NULL;
+        VBufferOnOpen[devnum] = NULL;
 
-static int gain[NB_CAM] = {SCE_CAMERA_GAIN_AUTO, SCE_CAMERA_GAIN_AUTO};
+        sceKernelLockMutex(imageMutex, 1, NULL);
+        loadRequest[devnum]++;
+        imageBuffers[devnum].ready = -1;
+        imageFormat[devnum] = SCE_CAMERA_FORMAT_INVALID;
+        StopCameraVideo(devnum);
+        ReleaseImage(devnum);
+        sceKernelUnlockMutex(imageMutex, 1);
 
-static tai_hook_ref_t ref_hook27;
-static int hook_sceCameraGetGain(int devnum, int *pMode)
-{
-    int res = TAI_CONTINUE(int, ref_hook27, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = gain[devnum];
-        res = 0;
-    }
-    return res;
-}
+    #endif
 
-static tai_hook_ref_t ref_hook28;
-static int hook_sceCameraSetGain(int devnum, int mode)
-{
-    int res = TAI_CONTINUE(int, ref_hook28, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
-    {
-        gain[devnum] = mode;
-        res = 0;
+        if (res < 0) res = 0;
     }
+    
+    HookCallEnd(HOOK_Close, hookStart);
+#ifdef ENABLE_BMP
+    if ((unsigned int)devnum < NB_CAM)
+        TraceEvent(TRACE_CLOSE, devnum, hookStart, 0, 0, res);
+#endif
     return res;
 }
 
-// WhiteBalance
-
-static int whiteBalance[NB_CAM] = {SCE_CAMERA_WB_AUTO, SCE_CAMERA_WB_AUTO};
+// Start - Stop
 
-static tai_hook_ref_t ref_hook29;
-static int hook_sceCameraGetWhiteBalance(int devnum, int *pMode)
+static int hook_sceCameraStart(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook29, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Start], devnum);
+    
+    if ((unsigned int)devnum < NB_CAM && cameraOpened[devnum])
     {
-        *pMode = whiteBalance[devnum];
-        res = 0;
+        cameraActive[devnum] = 1;
+        initTimeStamp[devnum] = sceKernelGetProcessTimeWide();
+        prevTimeStamp[devnum] = initTimeStamp[devnum];
+    #ifdef ENABLE_BMP
+        virtualTime[devnum] = initTimeStamp[devnum];
+        virtualFrame[devnum] = 1;
+        StartMotionSampler();
+        if (!producerActive[devnum])
+            StartFrameProducer(devnum);
+    #endif
+        if (res < 0) res = 0;
     }
+    
+    HookCallEnd(HOOK_Start, hookStart);
+#ifdef ENABLE_BMP
+    if ((unsigned int)devnum < NB_CAM)
+        TraceEvent(TRACE_START, devnum, hookStart, 0, 0, res);
+#endif
     return res;
 }
 
-static tai_hook_ref_t ref_hook30;
-static int hook_sceCameraSetWhiteBalance(int devnum, int mode)
+static int hook_sceCameraStop(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook30, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Stop], devnum);
+    
+    if ((unsigned int)devnum < NB_CAM)
     {
-        whiteBalance[devnum] = mode;
-        res = 0;
+        prevFrame[devnum] = 0;
+    #ifdef ENABLE_BMP
+        if (producerActive[devnum])
+            StopFrameProducer(devnum);
+        BlitState blitInit = BLIT_STATE_INIT;
+        blitTarget[devnum] = blitInit;
+        ResetBlitCache(&blitCaches[devnum]);
+    #endif
+
+        cameraActive[devnum] = 0;
+    #ifdef ENABLE_BMP
+        if (!cameraActive[0] && !cameraActive[1])
+            StopMotionSampler();
+    #endif
+        if (res < 0) res = 0;
     }
+    
+    HookCallEnd(HOOK_Stop, hookStart);
+#ifdef ENABLE_BMP
+    if ((unsigned int)devnum < NB_CAM)
+        TraceEvent(TRACE_STOP, devnum, hookStart, 0, 0, res);
+#endif
     return res;
 }
 
-// Backlight
-
-static int backlight[NB_CAM] = {SCE_CAMERA_BACKLIGHT_OFF, SCE_CAMERA_BACKLIGHT_OFF};
+// Read
 
-static tai_hook_ref_t ref_hook31;
-static int hook_sceCameraGetBacklight(int devnum, int *pMode)
+static int hook_sceCameraRead(int devnum, SceCameraRead *pRead)
 {
-    int res = TAI_CONTINUE(int, ref_hook31, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = backlight[devnum];
-        res = 0;
-    }
-    return res;
-}
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Read], devnum, pRead);
+#ifdef ENABLE_BMP
+    uint64_t copiedBytes = ((unsigned int)devnum < NB_CAM) ? blitCaches[devnum].copiedBytes : 0;
+#endif
+    
+    if ((unsigned int)devnum < NB_CAM && NULL != pRead && cameraActive[devnum])
+    {        
+        uint64_t newTimeStamp = timeSource->readTime(devnum);
 
-static tai_hook_ref_t ref_hook32;
-static int hook_sceCameraSetBacklight(int devnum, int mode)
-{
-    int res = TAI_CONTINUE(int, ref_hook32, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
-    {
-        backlight[devnum] = mode;
-        res = 0;
-    }
-    return res;
-}
+        if (res < 0)
+        {
+            if (READ_YIELD_ALWAYS == readYieldPolicy)
+                sceKernelDelayThread(1); // Release current thread time quantum to avoid freeze in some games (Frobisher Says)
+
+            uint64_t fakeTimeStamp = (newTimeStamp+prevTimeStamp[devnum])>>1;
+            uint64_t fakeFrame = FrameAt(devnum, fakeTimeStamp);
+            int waited = 0;
+
+            pRead->status = 0;
+            if (0 == pRead->mode)
+            {
+                // Simulate "wait next frame" time: sleep until the reported time stamp (average of this read and the
+                // previous one) reaches the next frame start, polling only when there is no frame rate
+                // With "readPacing", reads also end half a frame period after that start at the earliest: back to back
+                // reads then settle on frame middles and report frame start time stamps, instead of alternating short
+                // and long waits
+                while (prevFrame[devnum] >= fakeFrame)
+                {
+                    if (framerate[devnum] > 0)
+                    {
+                        uint64_t nextStart = FrameStart(devnum, prevFrame[devnum]+1);
+                        uint64_t deadline = 2*nextStart - prevTimeStamp[devnum];
+                        if (readPacingEnabled)
+                        {
+                            uint64_t middle = (nextStart + FrameStart(devnum, prevFrame[devnum]+2))>>1;
+                            deadline = (deadline > middle) ? deadline : middle;
+                        }
+                        newTimeStamp = timeSource->waitUntil(devnum, deadline);
+                    }
+                    else
+                    {
+                        sceKernelDelayThread(1000);
+                        newTimeStamp = timeSource->now(devnum);
+                    }
+                    waited = 1;
 
-// Nightmode
+                    fakeTimeStamp = (newTimeStamp+prevTimeStamp[devnum])>>1;
+                    fakeFrame = FrameAt(devnum, fakeTimeStamp);
+                }
+            }
+            else if (prevFrame[devnum] >= fakeFrame)
+                pRead->status = 2;
 
-static int nightmode[NB_CAM] = {SCE_CAMERA_NIGHTMODE_OFF, SCE_CAMERA_NIGHTMODE_OFF};
+            if (READ_YIELD_NO_WAIT == readYieldPolicy && !waited)
+                sceKernelDelayThread(1);
 
-static tai_hook_ref_t ref_hook33;
-static int hook_sceCameraGetNightmode(int devnum, int *pMode)
-{
-    int res = TAI_CONTINUE(int, ref_hook33, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = nightmode[devnum];
-        res = 0;
-    }
-    return res;
-}
+        #ifdef ENABLE_BMP
+            char* buffers[3] = {NULL, NULL, NULL};
+            if (NULL == ((SceCameraRead2*)pRead)->unknownNullCheck && sizeof(SceCameraRead2) == pRead->size)
+            {
+                SceCameraRead2* pRead2 = (SceCameraRead2*)pRead;
+                buffers[0] = (NULL != IBufferOnOpen[devnum]) ? IBufferOnOpen[devnum] : pRead2->pIBase;
+                buffers[1] = (NULL != UBufferOnOpen[devnum]) ? UBufferOnOpen[devnum] : pRead2->pUBase;
+                buffers[2] = (NULL != VBufferOnOpen[devnum]) ? VBufferOnOpen[devnum] : pRead2->pVBase;
+            }
+            else
+            {
+                buffers[0] = (NULL != IBufferOnOpen[devnum]) ? IBufferOnOpen[devnum] : pRead->pIBase;
+                buffers[1] = (NULL != UBufferOnOpen[devnum]) ? UBufferOnOpen[devnum] : pRead->pUBase;
+                buffers[2] = (NULL != VBufferOnOpen[devnum]) ? VBufferOnOpen[devnum] : pRead->pVBase;
+            }
+            
+            if (producerActive[devnum])
+            {
+                // Copy of the latest frame rendered by the producer
+                FrameProducer* producer = &producers[devnum];
+                if (producer->middle & PRODUCER_FRAME_NEW)
+                    producer->front = __sync_lock_test_and_set(&producer->middle, producer->front) & ~PRODUCER_FRAME_NEW;
 
-static tai_hook_ref_t ref_hook34;
-static int hook_sceCameraSetNightmode(int devnum, int mode)
-{
-    int res = TAI_CONTINUE(int, ref_hook34, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
-    {
-        nightmode[devnum] = mode;
-        res = 0;
+                int front = producer->front;
+                if (producer->frameIDs[front] > 0)
+                {
+                    if (producer->frameImages[front] > 0 && prevFrame[devnum] < fakeFrame)
+                        prevFrame[devnum] = fakeFrame;
+
+                    BlitState frameTarget = { {NULL, NULL, NULL}, FindCameraFormat(format[devnum]), width[devnum], height[devnum], 1, producer->frameIDs[front],
+                                              0, 0, 0, 0, width[devnum], height[devnum] };
+                    BlitCachedImage(&blitCaches[devnum], (void**)buffers, &frameTarget, &producer->frames[front]);
+                }
+            }
+            else
+            {
+                const ImageBuffers* image = NULL;
+                int shown = PrepareFrame(devnum, fakeFrame, (prevFrame[devnum] < fakeFrame), &blitTarget[devnum], &image);
+                if (shown > 0 && prevFrame[devnum] < fakeFrame)
+                    prevFrame[devnum] = fakeFrame;
+
+                // Buffers already holding the frame (when titles rotate them) are left untouched
+                if (shown >= 0)
+                    BlitCachedImage(&blitCaches[devnum], (void**)buffers, &blitTarget[devnum], image);
+            }
+        #endif
+            
+            pRead->frame = fakeFrame;
+            pRead->timestamp = fakeTimeStamp;
+            res = 0;
+        }
+
+        prevTimeStamp[devnum] = newTimeStamp;
     }
+
+    HookCallEnd(HOOK_Read, hookStart);
+#ifdef ENABLE_BMP
+    if ((unsigned int)devnum < NB_CAM && NULL != pRead)
+        TraceEvent(TRACE_READ, devnum, hookStart, pRead->frame, blitCaches[devnum].copiedBytes - copiedBytes, res);
+#endif
     return res;
 }
 
-// ExposureCeiling
-
-static int exposureCeiling[NB_CAM] = {0, 0};
+// Active
 
-static tai_hook_ref_t ref_hook35;
-static int hook_sceCameraGetExposureCeiling(int devnum, int *pMode)
+static int hook_sceCameraIsActive(int devnum)
 {
-    int res = TAI_CONTINUE(int, ref_hook35, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = exposureCeiling[devnum];
-        res = 0;
-    }
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_IsActive], devnum);
+    if ((unsigned int)devnum < NB_CAM && res <= 0) res = cameraActive[devnum];
+    HookCallEnd(HOOK_IsActive, hookStart);
     return res;
 }
 
-static tai_hook_ref_t ref_hook36;
-static int hook_sceCameraSetExposureCeiling(int devnum, int mode)
+// Location
+
+static int hook_sceCameraGetDeviceLocation(int devnum, SceFVector3 *pLocation)
 {
-    int res = TAI_CONTINUE(int, ref_hook36, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
-    {
-        exposureCeiling[devnum] = mode;
-        res = 0;
-    }
+    uint64_t hookStart = HookCallStart();
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_GetDeviceLocation], devnum, pLocation);
+    if ((unsigned int)devnum < NB_CAM && NULL != pLocation && res < 0) res = 0;
+    HookCallEnd(HOOK_GetDeviceLocation, hookStart);
     return res;
 }
 
-// AutoControlHold
-
-static int autoControlHold[NB_CAM] = {0, 0};
+// Getters - Setters
+// Settings are only stored, each getter gives back the last value of its setter
+
+#define CAMERA_SETTING_HOOKS(name, var, defaultValue)                                   \
+static int var[NB_CAM] = {defaultValue, defaultValue};                                  \
+                                                                                        \
+static int hook_sceCameraGet##name(int devnum, int *pValue)                             \
+{                                                                                       \
+    uint64_t hookStart = HookCallStart();                                               \
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Get##name], devnum, pValue);              \
+    if ((unsigned int)devnum < NB_CAM && NULL != pValue && res < 0)                     \
+    {                                                                                   \
+        *pValue = var[devnum];                                                          \
+        res = 0;                                                                        \
+    }                                                                                   \
+    HookCallEnd(HOOK_Get##name, hookStart);                                             \
+    return res;                                                                         \
+}                                                                                       \
+                                                                                        \
+static int hook_sceCameraSet##name(int devnum, int value)                               \
+{                                                                                       \
+    uint64_t hookStart = HookCallStart();                                               \
+    int res = TAI_CONTINUE(int, hookRefs[HOOK_Set##name], devnum, value);               \
+    if ((unsigned int)devnum < NB_CAM && res < 0)                                       \
+    {                                                                                   \
+        var[devnum] = value;                                                            \
+        res = 0;                                                                        \
+    }                                                                                   \
+    HookCallEnd(HOOK_Set##name, hookStart);                                             \
+    return res;                                                                         \
+}
 
-static tai_hook_ref_t ref_hook37;
-static int hook_sceCameraGetAutoControlHold(int devnum, int *pMode)
+CAMERA_SETTING_HOOKS(Saturation,      saturation,      SCE_CAMERA_SATURATION_0)
+CAMERA_SETTING_HOOKS(Brightness,      brightness,      127)
+CAMERA_SETTING_HOOKS(Contrast,        contrast,        127)
+CAMERA_SETTING_HOOKS(Sharpness,       sharpness,       SCE_CAMERA_SHARPNESS_100)
+CAMERA_SETTING_HOOKS(Reverse,         reverse,         SCE_CAMERA_REVERSE_OFF)
+CAMERA_SETTING_HOOKS(Effect,          effect,          SCE_CAMERA_EFFECT_NORMAL)
+CAMERA_SETTING_HOOKS(EV,              ev,              SCE_CAMERA_EV_POSITIVE_0)
+CAMERA_SETTING_HOOKS(Zoom,            zoom,            10)
+CAMERA_SETTING_HOOKS(AntiFlicker,     antiFlicker,     SCE_CAMERA_ANTIFLICKER_AUTO)
+CAMERA_SETTING_HOOKS(ISO,             iso,             SCE_CAMERA_ISO_AUTO)
+CAMERA_SETTING_HOOKS(Gain,            gain,            SCE_CAMERA_GAIN_AUTO)
+CAMERA_SETTING_HOOKS(WhiteBalance,    whiteBalance,    SCE_CAMERA_WB_AUTO)
+CAMERA_SETTING_HOOKS(Backlight,       backlight,       SCE_CAMERA_BACKLIGHT_OFF)
+CAMERA_SETTING_HOOKS(Nightmode,       nightmode,       SCE_CAMERA_NIGHTMODE_OFF)
+CAMERA_SETTING_HOOKS(ExposureCeiling, exposureCeiling, 0)
+CAMERA_SETTING_HOOKS(AutoControlHold, autoControlHold, 0)
+
+
+// Hooks table
+
+static const struct {
+    uint32_t nid;
+    const void* function;
+} hookTable[NB_HOOKS] = {
+#define HOOK_ENTRY(name, nid) { nid, &hook_sceCamera##name },
+    CAMERA_HOOKS(HOOK_ENTRY)
+#undef HOOK_ENTRY
+};
+
+// Exported: copies the statistics of hook iIndex to oStats and returns the number of hooks (only returns it when oStats
+// is NULL), or -1 when iIndex is out of range or the module is built without ENABLE_HOOK_STATS
+int fakeCameraGetHookStats(int iIndex, HookStats* oStats)
 {
-    int res = TAI_CONTINUE(int, ref_hook37, devnum, pMode);
-    if ((unsigned int)devnum < NB_CAM && NULL != pMode && res < 0)
-    {
-        *pMode = autoControlHold[devnum];
-        res = 0;
-    }
-    return res;
+#ifdef ENABLE_HOOK_STATS
+    if (NULL == oStats)
+        return NB_HOOKS;
+    if ((unsigned int)iIndex >= NB_HOOKS)
+        return -1;
+    *oStats = hookStats[iIndex];
+    oStats->nid = hookTable[iIndex].nid;
+    return NB_HOOKS;
+#else
+    return -1;
+#endif
 }
 
-static tai_hook_ref_t ref_hook38;
-static int hook_sceCameraSetAutoControlHold(int devnum, int mode)
+// Exported: copies the image loading statistics of camera iDevnum to oStats and returns 0, or -1 when iDevnum is out
+// of range or the module is built without ENABLE_BMP
+int fakeCameraGetLoadStats(int iDevnum, ImageLoadStats* oStats)
 {
-    int res = TAI_CONTINUE(int, ref_hook38, devnum, mode);
-    if ((unsigned int)devnum < NB_CAM && res < 0)
-    {
-        autoControlHold[devnum] = mode;
-        res = 0;
-    }
-    return res;
+#ifdef ENABLE_BMP
+    if ((unsigned int)iDevnum >= NB_CAM || NULL == oStats)
+        return -1;
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    *oStats = loadStats[iDevnum];
+    sceKernelUnlockMutex(imageMutex, 1);
+    return 0;
+#else
+    return -1;
+#endif
 }
 
+// Exported: copies the camera buffers writes of camera iDevnum to oStats and returns 0, or -1 when iDevnum is out of
+// range or the module is built without ENABLE_BMP
+int fakeCameraGetBlitStats(int iDevnum, BlitStats* oStats)
+{
+#ifdef ENABLE_BMP
+    if ((unsigned int)iDevnum >= NB_CAM || NULL == oStats)
+        return -1;
+    const BlitCache* blitCache = &blitCaches[iDevnum];
+    oStats->hits = blitCache->hits;
+    oStats->updates = blitCache->updates;
+    oStats->rewrites = blitCache->rewrites;
+    oStats->reserved = 0;
+    oStats->copiedBytes = blitCache->copiedBytes;
+    return 0;
+#else
+    return -1;
+#endif
+}
 
 void _start() __attribute__ ((weak, alias ("module_start")));
 int module_start(SceSize argc, const void *args)
@@ -1317,251 +3974,74 @@ int module_start(SceSize argc, const void *args)
 #ifdef ENABLE_BMP
     sceAppMgrAppParamGetString(0, 12, titleid , 16);
     //LOG("App ID %s\n", titleid);
+    LoadConfig(titleid);
+    if (config.virtualClock)
+        timeSource = &virtualTimeSource;
+#ifndef READ_WITH_KUIO
+    if (config.trace)
+        StartTrace();
+#endif
+    imageMutex = sceKernelCreateMutex("fakecamera_image", 0, 0, NULL);
+    arenaMutex = sceKernelCreateMutex("fakecamera_arena", 0, 0, NULL);
+    loaderMutex = sceKernelCreateMutex("fakecamera_loader", 0, 0, NULL);
+    for (int i = 0; i < NB_CAM; i++)
+    {
+        InitSharedImage(&sharedImages[i]);
+        ResetBlitCache(&blitCaches[i]);
+    }
 #endif
 
     //log_flush();
 
-    g_hooks[0] = taiHookFunctionImport(&ref_hook0, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xA462F801, // sceCameraOpen
-                                        hook_sceCameraOpen);
-    g_hooks[1] = taiHookFunctionImport(&ref_hook1, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xCD6E1CFC, // sceCameraClose
-                                        hook_sceCameraClose);
-    g_hooks[2] = taiHookFunctionImport(&ref_hook2, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xA8FEAE35, // sceCameraStart
-                                        hook_sceCameraStart);
-    g_hooks[3] = taiHookFunctionImport(&ref_hook3, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x1DD9C9CE, // sceCameraStop
-                                        hook_sceCameraStop);
-    g_hooks[4] = taiHookFunctionImport(&ref_hook4, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x79B5C2DE, // sceCameraRead
-                                        hook_sceCameraRead);
-    g_hooks[5] = taiHookFunctionImport(&ref_hook5, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x103A75B8, // sceCameraIsActive
-                                        hook_sceCameraIsActive);
-    g_hooks[6] = taiHookFunctionImport(&ref_hook6, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x274EF751, // sceCameraGetDeviceLocation
-                                        hook_sceCameraGetDeviceLocation);
-
-    // Getters - Setters
-    g_hooks[7] = taiHookFunctionImport(&ref_hook7, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x624F7653, // sceCameraGetSaturation
-                                        hook_sceCameraGetSaturation);
-    g_hooks[8] = taiHookFunctionImport(&ref_hook8, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xF9F7CA3D, // sceCameraSetSaturation
-                                        hook_sceCameraSetSaturation);
-    g_hooks[9] = taiHookFunctionImport(&ref_hook9, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x85D5951D, // sceCameraGetBrightness
-                                        hook_sceCameraGetBrightness);
-    g_hooks[10] = taiHookFunctionImport(&ref_hook10, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x98D71588, // sceCameraSetBrightness
-                                        hook_sceCameraSetBrightness);
-    g_hooks[11] = taiHookFunctionImport(&ref_hook11, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x8FBE84BE, // sceCameraGetContrast
-                                        hook_sceCameraGetContrast);
-    g_hooks[12] = taiHookFunctionImport(&ref_hook12, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x6FB2900, // sceCameraSetContrast
-                                        hook_sceCameraSetContrast);
-    g_hooks[13] = taiHookFunctionImport(&ref_hook13, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xAA72C3DC, // sceCameraGetSharpness
-                                        hook_sceCameraGetSharpness);
-    g_hooks[14] = taiHookFunctionImport(&ref_hook14, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xD1A5BB0B, // sceCameraSetSharpness
-                                        hook_sceCameraSetSharpness);
-    g_hooks[15] = taiHookFunctionImport(&ref_hook15, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x44F6043F, // sceCameraGetReverse
-                                        hook_sceCameraGetReverse);
-    g_hooks[16] = taiHookFunctionImport(&ref_hook16, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x1175F477, // sceCameraSetReverse
-                                        hook_sceCameraSetReverse);
-    g_hooks[17] = taiHookFunctionImport(&ref_hook17, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x7E8EF3B2, // sceCameraGetEffect
-                                        hook_sceCameraGetEffect);
-    g_hooks[18] = taiHookFunctionImport(&ref_hook18, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xE9D2CFB1, // sceCameraSetEffect
-                                        hook_sceCameraSetEffect);
-    g_hooks[19] = taiHookFunctionImport(&ref_hook19, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x8B5E6147, // sceCameraGetEV
-                                        hook_sceCameraGetEV);
-    g_hooks[20] = taiHookFunctionImport(&ref_hook20, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x62AFF0B8, // sceCameraSetEV
-                                        hook_sceCameraSetEV);
-    g_hooks[21] = taiHookFunctionImport(&ref_hook21, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x06D3816C, // sceCameraGetZoom
-                                        hook_sceCameraGetZoom);
-    g_hooks[22] = taiHookFunctionImport(&ref_hook22, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xF7464216, // sceCameraSetZoom
-                                        hook_sceCameraSetZoom);
-    g_hooks[23] = taiHookFunctionImport(&ref_hook23, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x9FDACB99, // sceCameraGetAntiFlicker
-                                        hook_sceCameraGetAntiFlicker);
-    g_hooks[24] = taiHookFunctionImport(&ref_hook24, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xE312958A, // sceCameraSetAntiFlicker
-                                        hook_sceCameraSetAntiFlicker);
-    g_hooks[25] = taiHookFunctionImport(&ref_hook25, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x4EBD5C68, // sceCameraGetISO
-                                        hook_sceCameraGetISO);
-    g_hooks[26] = taiHookFunctionImport(&ref_hook26, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x3CF630A1, // sceCameraSetISO
-                                        hook_sceCameraSetISO);
-    g_hooks[27] = taiHookFunctionImport(&ref_hook27, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x2C36D6F3, // sceCameraGetGain
-                                        hook_sceCameraGetGain);
-    g_hooks[28] = taiHookFunctionImport(&ref_hook28, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xE65CFE86, // sceCameraSetGain
-                                        hook_sceCameraSetGain);
-    g_hooks[29] = taiHookFunctionImport(&ref_hook29, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xDBFFA1DA, // sceCameraGetWhiteBalance
-                                        hook_sceCameraGetWhiteBalance);                                        
-    g_hooks[30] = taiHookFunctionImport(&ref_hook30, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x4D4514AC, // sceCameraSetWhiteBalance
-                                        hook_sceCameraSetWhiteBalance);
-    g_hooks[31] = taiHookFunctionImport(&ref_hook31, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x8DD1292B, // sceCameraGetBacklight
-                                        hook_sceCameraGetBacklight);
-    g_hooks[32] = taiHookFunctionImport(&ref_hook32, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0xAE071044, // sceCameraSetBacklight
-                                        hook_sceCameraSetBacklight);
-    g_hooks[33] = taiHookFunctionImport(&ref_hook33, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x12B6FF26, // sceCameraGetNightmode
-                                        hook_sceCameraGetNightmode);
-    g_hooks[34] = taiHookFunctionImport(&ref_hook34, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x3F26233E, // sceCameraSetNightmode
-                                        hook_sceCameraSetNightmode);
-    g_hooks[35] = taiHookFunctionImport(&ref_hook35, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x5FA5B1BB, // sceCameraGetExposureCeiling
-                                        hook_sceCameraGetExposureCeiling);
-    g_hooks[36] = taiHookFunctionImport(&ref_hook36, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x4F34BEE, // sceCameraSetExposureCeiling
-                                        hook_sceCameraSetExposureCeiling);
-    g_hooks[37] = taiHookFunctionImport(&ref_hook37, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x06A21BBB, // sceCameraGetAutoControlHold
-                                        hook_sceCameraGetAutoControlHold);
-    g_hooks[38] = taiHookFunctionImport(&ref_hook38, 
-                                        TAI_MAIN_MODULE,
-                                        0xDA91B3ED, // SceCamera
-                                        0x3A0DABBD, // sceCameraSetAutoControlHold
-                                        hook_sceCameraSetAutoControlHold);
+    for (int i = 0; i < NB_HOOKS; i++)
+        g_hooks[i] = taiHookFunctionImport(&hookRefs[i], TAI_MAIN_MODULE, 0xDA91B3ED /* SceCamera */, hookTable[i].nid, hookTable[i].function);
     return SCE_KERNEL_START_SUCCESS;
 }
 
 int module_stop(SceSize argc, const void *args)
 {
-    if (g_hooks[0] >= 0) taiHookRelease(g_hooks[0], ref_hook0);
-    if (g_hooks[1] >= 0) taiHookRelease(g_hooks[1], ref_hook1);
-    if (g_hooks[2] >= 0) taiHookRelease(g_hooks[2], ref_hook2);
-    if (g_hooks[3] >= 0) taiHookRelease(g_hooks[3], ref_hook3);
-    if (g_hooks[4] >= 0) taiHookRelease(g_hooks[4], ref_hook4);
-    if (g_hooks[5] >= 0) taiHookRelease(g_hooks[5], ref_hook5);
-    if (g_hooks[6] >= 0) taiHookRelease(g_hooks[6], ref_hook6);
-    if (g_hooks[7] >= 0) taiHookRelease(g_hooks[7], ref_hook7);
-    if (g_hooks[8] >= 0) taiHookRelease(g_hooks[8], ref_hook8);
-    if (g_hooks[9] >= 0) taiHookRelease(g_hooks[9], ref_hook9);
-    if (g_hooks[10] >= 0) taiHookRelease(g_hooks[10], ref_hook10);
-    if (g_hooks[11] >= 0) taiHookRelease(g_hooks[11], ref_hook11);
-    if (g_hooks[12] >= 0) taiHookRelease(g_hooks[12], ref_hook12);
-    if (g_hooks[13] >= 0) taiHookRelease(g_hooks[13], ref_hook13);
-    if (g_hooks[14] >= 0) taiHookRelease(g_hooks[14], ref_hook14);
-    if (g_hooks[15] >= 0) taiHookRelease(g_hooks[15], ref_hook15);
-    if (g_hooks[16] >= 0) taiHookRelease(g_hooks[16], ref_hook16);
-    if (g_hooks[17] >= 0) taiHookRelease(g_hooks[17], ref_hook17);
-    if (g_hooks[18] >= 0) taiHookRelease(g_hooks[18], ref_hook18);
-    if (g_hooks[19] >= 0) taiHookRelease(g_hooks[19], ref_hook19);
-    if (g_hooks[20] >= 0) taiHookRelease(g_hooks[20], ref_hook20);
-    if (g_hooks[21] >= 0) taiHookRelease(g_hooks[21], ref_hook21);
-    if (g_hooks[22] >= 0) taiHookRelease(g_hooks[22], ref_hook22);
-    if (g_hooks[23] >= 0) taiHookRelease(g_hooks[23], ref_hook23);
-    if (g_hooks[24] >= 0) taiHookRelease(g_hooks[24], ref_hook24);
-    if (g_hooks[25] >= 0) taiHookRelease(g_hooks[25], ref_hook25);
-    if (g_hooks[26] >= 0) taiHookRelease(g_hooks[26], ref_hook26);
-    if (g_hooks[27] >= 0) taiHookRelease(g_hooks[27], ref_hook27);
-    if (g_hooks[28] >= 0) taiHookRelease(g_hooks[28], ref_hook28);
-    if (g_hooks[29] >= 0) taiHookRelease(g_hooks[29], ref_hook29);
-    if (g_hooks[30] >= 0) taiHookRelease(g_hooks[30], ref_hook30);
-    if (g_hooks[31] >= 0) taiHookRelease(g_hooks[31], ref_hook31);
-    if (g_hooks[32] >= 0) taiHookRelease(g_hooks[32], ref_hook32);
-    if (g_hooks[33] >= 0) taiHookRelease(g_hooks[33], ref_hook33);
-    if (g_hooks[34] >= 0) taiHookRelease(g_hooks[34], ref_hook34);
-    if (g_hooks[35] >= 0) taiHookRelease(g_hooks[35], ref_hook35);
-    if (g_hooks[36] >= 0) taiHookRelease(g_hooks[36], ref_hook36);
-    if (g_hooks[37] >= 0) taiHookRelease(g_hooks[37], ref_hook37);
-    if (g_hooks[38] >= 0) taiHookRelease(g_hooks[38], ref_hook38);
+    // No new camera call reaches the plugin once hooks are released, helper threads and memory go next
+    for (int i = 0; i < NB_HOOKS; i++)
+    {
+        if (g_hooks[i] >= 0) taiHookRelease(g_hooks[i], hookRefs[i]);
+    }
+
+#ifdef ENABLE_BMP
+    for (int i = 0; i < NB_CAM; i++)
+    {
+        if (producerActive[i])
+            StopFrameProducer(i);
+    }
+    StopMotionSampler();
+
+    // Let background loaders discard their images before the module goes away
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    for (int i = 0; i < NB_CAM; i++)
+        loadRequest[i]++;
+    sceKernelUnlockMutex(imageMutex, 1);
+    JoinLoaderThreads(1);
+    sceKernelLockMutex(imageMutex, 1, NULL);
+    for (int i = 0; i < NB_CAM; i++)
+        StopCameraVideo(i);
+    sceKernelUnlockMutex(imageMutex, 1);
+    //LOG("Memory arena: %u bytes used at most, %u allocations outside\n", arena.peak, arena.fallbacks);
+
+    // Images don't outlive the module
+    ImageBuffers buffersInit = IMAGE_BUFFERS_INIT;
+    for (int i = 0; i < NB_CAM; i++)
+    {
+        imageBuffers[i] = buffersInit;
+        cameraImage[i] = -1;
+        FreeSharedImage(&sharedImages[i]);
+    }
+    if (arena.blockID >= 0)
+        sceKernelFreeMemBlock(arena.blockID);
+    MemoryArena arenaInit = { -1, NULL, 0, 0, 0, {0}, {0}, 0, 0, 0 };
+    arena = arenaInit;
+#endif
+#if defined(ENABLE_BMP) && !defined(READ_WITH_KUIO)
+    StopTrace();
+#endif
 
     return SCE_KERNEL_STOP_SUCCESS;
 }
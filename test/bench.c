@@ -0,0 +1,486 @@
+// Host benchmarks of the BMP loader, of BMP pixels conversion (generic path of version 1.2 against specialized row
+// converters) and of the camera buffers blit
+// Results are CSV lines on stdout: benchmark,format,bits,width,height,case,ns_per_pixel,ns_per_frame,mb_per_s
+// With --jitter, camera reads pacing is measured instead (CSV lines: benchmark,framerate,case,reads,mean_abs_jitter_us,max_abs_jitter_us,delays_per_read)
+// Usage: fakecamera_bench [--quick] [--jitter]
+
+#include "main.c"
+#include "testutil.h"
+
+static const SceCameraFormat benchFormats[] = {
+    SCE_CAMERA_FORMAT_ARGB, SCE_CAMERA_FORMAT_ABGR, SCE_CAMERA_FORMAT_YUV422_PACKED,
+    SCE_CAMERA_FORMAT_YUV422_PLANE, SCE_CAMERA_FORMAT_YUV420_PLANE, SCE_CAMERA_FORMAT_RAW8 };
+
+static const unsigned int benchSizes[][2] = { {160, 120}, {320, 240}, {640, 480} };
+
+static const unsigned int benchBits[] = { 16, 24, 32 };
+
+#define NB_BENCH_FORMATS (sizeof(benchFormats)/sizeof(benchFormats[0]))
+
+static uint64_t minBenchTime = 200000000; // Nanoseconds spent on each case at least
+
+static void PrintResult(const char* iBenchmark, SceCameraFormat iFormat, unsigned int iBits, unsigned int iWidth, unsigned int iHeight,
+                        const char* iCase, double iNsPerPixel, double iNsPerFrame, double iMBPerS)
+{
+    printf("%s,%s,%u,%u,%u,%s,%.3f,%.0f,%.1f\n", iBenchmark, FormatName(iFormat), iBits, iWidth, iHeight, iCase, iNsPerPixel, iNsPerFrame, iMBPerS);
+    fflush(stdout);
+}
+
+// LoadBMPFile from a file in the page cache, MB/s of BMP pixels
+static int BenchLoader(const char* iDir)
+{
+    for (int s = 0; s < sizeof(benchSizes)/sizeof(benchSizes[0]); s++)
+    {
+        for (int b = 0; b < sizeof(benchBits)/sizeof(benchBits[0]); b++)
+        {
+            unsigned int width = benchSizes[s][0];
+            unsigned int height = benchSizes[s][1];
+            char path[128];
+            snprintf(path, sizeof(path), "%s/bench_%u_%u_%u.bmp", iDir, width, height, benchBits[b]);
+            if (WriteTestBMP(path, width, height, benchBits[b], 1) < 0)
+                return -1;
+
+            for (int f = 0; f < NB_BENCH_FORMATS; f++)
+            {
+                uint64_t ioWait = 0;
+                uint64_t compute = 0;
+                unsigned int count = 0;
+                uint64_t start = NowNs();
+                uint64_t elapsed = 0;
+                do
+                {
+                    BitmapPixels pixels;
+                    ImageBuffers buffers;
+                    LoadStats stats;
+                    if (LoadTestImage(path, benchFormats[f], &pixels, &buffers, &stats) < 0)
+                        return -1;
+                    FreeBitmapPixels(&pixels);
+                    FreeImageBuffers(&buffers);
+                    ioWait += stats.ioWaitTime;
+                    compute += stats.computeTime;
+                    count++;
+                    elapsed = NowNs() - start;
+                } while (elapsed < minBenchTime);
+
+                double nsPerFrame = (double)elapsed/count;
+                double bytes = (double)((width*(benchBits[b]/8) + 3) & ~3)*height;
+                PrintResult("load", benchFormats[f], benchBits[b], width, height, "file", nsPerFrame/(width*height), nsPerFrame, bytes*1000./nsPerFrame);
+                PrintResult("load", benchFormats[f], benchBits[b], width, height, "io_wait", 1000.*ioWait/count/(width*height), 1000.*ioWait/count, 0.);
+                PrintResult("load", benchFormats[f], benchBits[b], width, height, "compute", 1000.*compute/count/(width*height), 1000.*compute/count, 0.);
+            }
+            remove(path);
+        }
+    }
+    return 0;
+}
+
+// Generic decode path of version 1.2 (per pixel depth check and write callback, float matrix), the reference of the
+// specialized row converters
+
+typedef void (*GenericWriteFunc)(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor);
+
+static void GenericABGRWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+{
+    ((unsigned int*)oBuffers->blocksData[0])[iGlobalPos] = iColor;
+}
+
+static void GenericARGBWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+{
+    ((unsigned int*)oBuffers->blocksData[0])[iGlobalPos] = (iColor&0xFF00FF00) | (iColor&0xFF)<<16 | (iColor&0xFF0000)>>16;
+}
+
+static float genericMat[3][3] = { {0.299f, 0.587f, 0.114f}, {-0.14317f, -0.28886f, 0.436f}, {0.615f, -0.51499f, -0.10001f} };
+
+typedef struct {
+    unsigned int globalPos[2];
+    unsigned int colors[4];
+} GenericYUVData;
+
+static void GenericToYUV(GenericYUVData* iData, int iCount, float* Y, float* Cb, float* Cr)
+{
+    for (int i = 0; i < iCount; i++)
+    {
+        unsigned int color = iData->colors[i];
+        float nR = (float)(color&0xFF);
+        float nG = (float)((color&0xFF00)>>8);
+        float nB = (float)((color&0xFF0000)>>16);
+        Y[i] = genericMat[0][0] * nR + genericMat[0][1] * nG + genericMat[0][2] * nB;
+        Cb[i] = genericMat[1][0] * nR + genericMat[1][1] * nG + genericMat[1][2] * nB + 128.f;
+        Cr[i] = genericMat[2][0] * nR + genericMat[2][1] * nG + genericMat[2][2] * nB + 128.f;
+    }
+}
+
+static void GenericYUV422PackedWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+{
+    GenericYUVData* data = (GenericYUVData*)iFuncData;
+    if (0 == iWidthPos%2)
+    {
+        data->globalPos[0] = iGlobalPos;
+        data->colors[0] = iColor;
+        return;
+    }
+    data->colors[1] = iColor;
+    float Y[2], Cb[2], Cr[2];
+    GenericToYUV(data, 2, Y, Cb, Cr);
+    ((unsigned short*)oBuffers->blocksData[0])[data->globalPos[0]] = (((unsigned char)Y[0])<<8) | (unsigned char)((Cb[0]+Cb[1])/2.f);
+    ((unsigned short*)oBuffers->blocksData[0])[iGlobalPos] = (((unsigned char)Y[1])<<8) | (unsigned char)((Cr[0]+Cr[1])/2.f);
+}
+
+static void GenericYUV422PlaneWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+{
+    GenericYUVData* data = (GenericYUVData*)iFuncData;
+    if (0 == iWidthPos%2)
+    {
+        data->globalPos[0] = iGlobalPos;
+        data->colors[0] = iColor;
+        return;
+    }
+    data->colors[1] = iColor;
+    float Y[2], Cb[2], Cr[2];
+    GenericToYUV(data, 2, Y, Cb, Cr);
+    ((unsigned char*)oBuffers->blocksData[0])[data->globalPos[0]] = (unsigned char)Y[0];
+    ((unsigned char*)oBuffers->blocksData[0])[iGlobalPos] = (unsigned char)Y[1];
+    ((unsigned char*)oBuffers->blocksData[1])[data->globalPos[0]/2] = (unsigned char)((Cb[0]+Cb[1])/2.f);
+    ((unsigned char*)oBuffers->blocksData[2])[data->globalPos[0]/2] = (unsigned char)((Cr[0]+Cr[1])/2.f);
+}
+
+static void GenericYUV420PlaneWrite(void* iFuncData, ImageBuffers* oBuffers, unsigned int iGlobalPos, uint16_t iWidthPos, uint16_t iHeightPos, unsigned int iColor)
+{
+    GenericYUVData* data = (GenericYUVData*)iFuncData;
+    unsigned int pixelPosInBlock = iWidthPos%2+((iHeightPos%2)<<1);
+    if (0 == iWidthPos%2)
+        data->globalPos[iHeightPos%2] = iGlobalPos;
+    data->colors[pixelPosInBlock] = iColor;
+    if (pixelPosInBlock < 3)
+        return;
+    float Y[4], Cb[4], Cr[4];
+    GenericToYUV(data, 4, Y, Cb, Cr);
+    ((unsigned short*)oBuffers->blocksData[0])[data->globalPos[0]/2] = (unsigned char)Y[0] | (((unsigned char)Y[1])<<8);
+    ((unsigned short*)oBuffers->blocksData[0])[data->globalPos[1]/2] = (unsigned char)Y[2] | (((unsigned char)Y[3])<<8);
+    ((unsigned char*)oBuffers->blocksData[1])[(data->globalPos[1]+(iWidthPos-1))/4] = (unsigned char)((Cb[0]+Cb[1]+Cb[2]+Cb[3])/4.f);
+    ((unsigned char*)oBuffers->blocksData[2])[(data->globalPos[1]+(iWidthPos-1))/4] = (unsigned char)((Cr[0]+Cr[1]+Cr[2]+Cr[3])/4.f);
+}
+
+static unsigned int GenericReadColor(const unsigned char* buffer, unsigned short bitCount, unsigned int row_stride, int col, int row)
+{
+    unsigned int imgColor = 0;
+    if (bitCount == 32) {
+        unsigned int color = *(const unsigned int *)(buffer + row*row_stride + col*4);
+        imgColor = ((color>>24)&0xFF)<<24 | (color&0xFF)<<16 | ((color>>8)&0xFF)<<8 | ((color>>16)&0xFF);
+    } else if (bitCount == 24) {
+        const unsigned char *address = buffer + row*row_stride + col*3;
+        imgColor = (*address)<<16 | (*(address+1))<<8 | (*(address+2)) | (0xFF<<24);
+    } else if (bitCount == 16) {
+        unsigned int color = *(const unsigned short *)(buffer + row*row_stride + col*2);
+        unsigned char r = (color       & 0x1F)  *((float)255/31);
+        unsigned char g = ((color>>5)  & 0x3F)  *((float)255/63);
+        unsigned char b = ((color>>11) & 0x1F)  *((float)255/31);
+        imgColor = ((r<<16) | (g<<8) | b | (0xFF<<24));
+    }
+    return imgColor;
+}
+
+// Version 1.2 LoadBMPGeneric loops on BMP pixels already in memory (RAW8 didn't exist)
+static int GenericConvert(const BitmapPixels* iPixels, SceCameraFormat iFormat, ImageBuffers* oBuffers)
+{
+    GenericWriteFunc write;
+    switch (iFormat)
+    {
+        case SCE_CAMERA_FORMAT_ABGR: write = &GenericABGRWrite; break;
+        case SCE_CAMERA_FORMAT_ARGB: write = &GenericARGBWrite; break;
+        case SCE_CAMERA_FORMAT_YUV422_PACKED: write = &GenericYUV422PackedWrite; break;
+        case SCE_CAMERA_FORMAT_YUV422_PLANE: write = &GenericYUV422PlaneWrite; break;
+        case SCE_CAMERA_FORMAT_YUV420_PLANE: write = &GenericYUV420PlaneWrite; break;
+        default: return -1;
+    }
+
+    GenericYUVData data;
+    unsigned int alignedWidth = oBuffers->imageWidth;
+    unsigned int alignedHeight = oBuffers->imageHeight;
+    for (unsigned int b = 0; b < alignedHeight/oBuffers->heightAlign; b++)
+    {
+        const unsigned char* buffer = iPixels->data + b*oBuffers->heightAlign*iPixels->rowStride;
+        for (unsigned int i = 0; i < alignedWidth; i += oBuffers->widthAlign)
+        {
+            for (unsigned int j = 0; j < oBuffers->heightAlign; j++)
+            {
+                unsigned int y = b*oBuffers->heightAlign + j;
+                for (unsigned int x = i; x < i+oBuffers->widthAlign; x++)
+                    write(&data, oBuffers, (alignedHeight - 1 - y)*alignedWidth + x, x, y, GenericReadColor(buffer, iPixels->bits, iPixels->rowStride, x, j));
+            }
+        }
+    }
+    return 1;
+}
+
+// In memory conversion of BMP pixels, generic path against specialized row converters
+static int BenchConvert(const char* iDir)
+{
+    unsigned int width = 640;
+    unsigned int height = 480;
+    for (int b = 0; b < sizeof(benchBits)/sizeof(benchBits[0]); b++)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/convert.bmp", iDir);
+        BitmapPixels pixels;
+        ImageBuffers loaded;
+        LoadStats stats;
+        // YUV420 keeps BMP pixels in memory when "imageMemoryLimit" lets it
+        config.imageMemoryLimit = 1 << 20;
+        int res = (WriteTestBMP(path, width, height, benchBits[b], 3) < 0) ? -1 : LoadTestImage(path, SCE_CAMERA_FORMAT_YUV420_PLANE, &pixels, &loaded, &stats);
+        config.imageMemoryLimit = 0;
+        if (res < 0)
+            return -1;
+        FreeImageBuffers(&loaded);
+        remove(path);
+
+        for (int f = 0; f < NB_BENCH_FORMATS; f++)
+        {
+            for (int generic = 0; generic < 2; generic++)
+            {
+                ImageBuffers buffers = IMAGE_BUFFERS_INIT;
+                SetImageGeometry(FindCameraFormat(benchFormats[f]), pixels.width, pixels.height, &buffers);
+                if (AllocImageBuffers("bench", &buffers) < 0)
+                    return -1;
+
+                unsigned int count = 0;
+                uint64_t start = NowNs();
+                uint64_t elapsed = 0;
+                int res = 1;
+                do
+                {
+                    if (generic)
+                        res = GenericConvert(&pixels, benchFormats[f], &buffers);
+                    else
+                        ConvertBitmapRows(pixels.data, pixels.rowStride, 0, buffers.imageHeight, &buffers, FindCameraFormat(benchFormats[f])->convert[pixels.bits/8 - 2]);
+                    count++;
+                    elapsed = NowNs() - start;
+                } while (res >= 0 && elapsed < minBenchTime);
+                FreeImageBuffers(&buffers);
+
+                if (res >= 0)
+                {
+                    double nsPerFrame = (double)elapsed/count;
+                    PrintResult("convert", benchFormats[f], benchBits[b], width, height, generic ? "generic" : "specialized",
+                                nsPerFrame/(width*height), nsPerFrame, (double)pixels.rowStride*height*1000./nsPerFrame);
+                }
+            }
+        }
+        FreeBitmapPixels(&pixels);
+    }
+    return 0;
+}
+
+// Camera buffers of a given format and resolution
+static void* AllocCameraBuffers(const CameraFormatDesc* iDesc, unsigned int iWidth, unsigned int iHeight, void* oBuffers[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        oBuffers[i] = NULL;
+        if (iDesc->texelBits[i] > 0)
+            oBuffers[i] = calloc(iWidth*iHeight*iDesc->texelBits[i]/8, 1);
+    }
+    return oBuffers[0];
+}
+
+static void FreeCameraBuffers(void* ioBuffers[3])
+{
+    for (int i = 0; i < 3; i++)
+        free(ioBuffers[i]);
+}
+
+// Blit of each read in hook_sceCameraRead: unchanged frame, new image frame at the same place, scrolled image (image
+// larger than buffers) and scrolled image with black borders (image smaller than buffers)
+static int BenchBlit(const char* iDir)
+{
+    static const char* cases[] = { "unchanged", "new_frame", "scroll", "scroll_borders" };
+    unsigned int bufWidth = 320;
+    unsigned int bufHeight = 240;
+
+    for (int f = 0; f < NB_BENCH_FORMATS; f++)
+    {
+        const CameraFormatDesc* desc = FindCameraFormat(benchFormats[f]);
+        for (int c = 0; c < sizeof(cases)/sizeof(cases[0]); c++)
+        {
+            unsigned int imgWidth = (3 == c) ? 160 : 640;
+            unsigned int imgHeight = (3 == c) ? 120 : 480;
+            char path[128];
+            snprintf(path, sizeof(path), "%s/blit.bmp", iDir);
+            BitmapPixels pixels;
+            ImageBuffers image;
+            LoadStats stats;
+            if (WriteTestBMP(path, imgWidth, imgHeight, 24, 2) < 0 || LoadTestImage(path, benchFormats[f], &pixels, &image, &stats) < 0)
+                return -1;
+
+            void* buffers[3];
+            AllocCameraBuffers(desc, bufWidth, bufHeight, buffers);
+            BlitCache cache;
+            memset(&cache, 0, sizeof(cache));
+            ResetBlitCache(&cache);
+
+            unsigned int count = 0;
+            uint64_t start = NowNs();
+            uint64_t elapsed = 0;
+            do
+            {
+                unsigned int width = (imgWidth < bufWidth) ? imgWidth : bufWidth;
+                unsigned int height = (imgHeight < bufHeight) ? imgHeight : bufHeight;
+                unsigned int offset = (count & 1) ? 8 : 0;
+                BlitState target = { {NULL, NULL, NULL}, desc, bufWidth, bufHeight, 1, 0, 0, 0, 0, 0, width, height };
+                if (1 == c)
+                    target.generation = count+1;
+                else if (2 == c)
+                {
+                    target.imgX = offset;
+                    target.imgY = offset;
+                }
+                else if (3 == c)
+                {
+                    target.bufX = offset;
+                    target.bufY = offset;
+                }
+                BlitCachedImage(&cache, buffers, &target, &image);
+                count++;
+                if (0 == (count & 0xFF))
+                    elapsed = NowNs() - start;
+            } while (elapsed < minBenchTime);
+
+            double nsPerFrame = (double)elapsed/count;
+            PrintResult("blit", benchFormats[f], 24, bufWidth, bufHeight, cases[c], nsPerFrame/(bufWidth*bufHeight), nsPerFrame,
+                        (double)cache.copiedBytes*1000./elapsed);
+            FreeCameraBuffers(buffers);
+            FreeBitmapPixels(&pixels);
+            FreeImageBuffers(&image);
+            remove(path);
+        }
+    }
+    return 0;
+}
+
+// Blocking camera reads (mode 0) at the camera frame rate: deviation of the intervals between read returns from the
+// frame period, and sceKernelDelayThread calls by read, for each "readYield" policy (with and without "readPacing") and
+// for the former 1 ms polling loop
+
+static void PrintJitter(unsigned int iRate, const char* iCase, unsigned int iReads, double iSumJitter, double iMaxJitter, int iDelays)
+{
+    printf("jitter,%u,%s,%u,%.1f,%.1f,%.2f\n", iRate, iCase, iReads, iSumJitter/iReads, iMaxJitter, (double)iDelays/iReads);
+    fflush(stdout);
+}
+
+// Wait loop of version 1.2 with an exact frame number: 1 ms sleeps until the time stamp (average of this read and the
+// previous one) reaches the next frame, then a yield
+static void FormerPollingRead(uint64_t iStart, uint64_t iNum, uint64_t iDen, uint64_t* ioFrame, uint64_t* ioTimeStamp)
+{
+    uint64_t now = sceKernelGetProcessTimeWide();
+    uint64_t frame = (((now+*ioTimeStamp)/2-iStart)*iNum)/(1000000*iDen) + 1;
+    while (frame <= *ioFrame)
+    {
+        sceKernelDelayThread(1000);
+        now = sceKernelGetProcessTimeWide();
+        frame = (((now+*ioTimeStamp)/2-iStart)*iNum)/(1000000*iDen) + 1;
+    }
+    sceKernelDelayThread(1);
+    *ioFrame = frame;
+    *ioTimeStamp = now;
+}
+
+static int BenchReadJitter(const char* iDir, unsigned int iReads)
+{
+    static const unsigned int rates[] = { SCE_CAMERA_FRAMERATE_30_FPS, SCE_CAMERA_FRAMERATE_60_FPS };
+    static const struct {
+        const char* name;
+        int policy;
+        int pacing;
+    } cases[] = { {"yield_never", READ_YIELD_NEVER, 0}, {"yield_always", READ_YIELD_ALWAYS, 0}, {"yield_no_wait", READ_YIELD_NO_WAIT, 0},
+                  {"yield_never_paced", READ_YIELD_NEVER, 1}, {"yield_always_paced", READ_YIELD_ALWAYS, 1},
+                  {"yield_no_wait_paced", READ_YIELD_NO_WAIT, 1}, {"former_polling", -1, 0} };
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/data/FakeCamera/ALL.bmp", iDir);
+    if (WriteTestBMP(path, 640, 480, 24, 4) < 0)
+        return -1;
+    module_start(0, NULL);
+    config.imageCache = 0;
+
+    printf("benchmark,framerate,case,reads,mean_abs_jitter_us,max_abs_jitter_us,delays_per_read\n");
+    int res = 0;
+    for (int r = 0; r < sizeof(rates)/sizeof(rates[0]) && res >= 0; r++)
+    {
+        double period = 1000000./rates[r];
+        for (int c = 0; c < sizeof(cases)/sizeof(cases[0]) && res >= 0; c++)
+        {
+            TestCamera camera;
+            if (OpenTestCamera(0, SCE_CAMERA_FORMAT_YUV420_PLANE, SCE_CAMERA_RESOLUTION_640_480, rates[r], &camera) < 0 || WaitTestImage(0) < 0)
+                res = -1;
+            config.readYield = cases[c].policy;
+            config.readPacing = cases[c].pacing;
+
+            SceCameraRead read;
+            uint64_t start = sceKernelGetProcessTimeWide();
+            uint64_t formerFrame = 0;
+            uint64_t formerTimeStamp = start;
+            double sumJitter = 0.;
+            double maxJitter = 0.;
+            int delays = 0;
+            uint64_t last = 0;
+            // First reads let the pacing settle
+            const unsigned int warmup = 5;
+            for (unsigned int i = 0; i < warmup+iReads && res >= 0; i++)
+            {
+                int delayStart = hostDelayCount();
+                if (cases[c].policy < 0)
+                    FormerPollingRead(start, rates[r], 1, &formerFrame, &formerTimeStamp);
+                else
+                    res = ReadTestCamera(0, 0, &read);
+                uint64_t now = sceKernelGetProcessTimeWide();
+                if (i >= warmup)
+                {
+                    double jitter = (double)(now-last) - period;
+                    jitter = (jitter < 0.) ? -jitter : jitter;
+                    sumJitter += jitter;
+                    maxJitter = (jitter > maxJitter) ? jitter : maxJitter;
+                    delays += hostDelayCount() - delayStart;
+                }
+                last = now;
+            }
+            CloseTestCamera(0, &camera);
+            if (res >= 0)
+                PrintJitter(rates[r], cases[c].name, iReads, sumJitter, maxJitter, delays);
+        }
+    }
+    module_stop(0, NULL);
+    return res;
+}
+
+int main(int argc, char* argv[])
+{
+    int quick = 0;
+    int jitter = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        quick |= (0 == strcmp(argv[i], "--quick"));
+        jitter |= (0 == strcmp(argv[i], "--jitter"));
+    }
+    if (quick)
+        minBenchTime = 0;
+
+    const char* dir = MakeTempRoot();
+    if (NULL == dir)
+        return 1;
+
+    int res;
+    if (jitter)
+        res = BenchReadJitter(dir, quick ? 10 : 300);
+    else
+    {
+        config.imageCache = 0;
+        printf("benchmark,format,bits,width,height,case,ns_per_pixel,ns_per_frame,mb_per_s\n");
+        res = (BenchLoader(dir) < 0 || BenchConvert(dir) < 0 || BenchBlit(dir) < 0) ? -1 : 0;
+    }
+    if (res < 0)
+    {
+        fprintf(stderr, "Benchmark failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Host implementation of the file system functions declared in vita_host.h (not linked in READ_WITH_KUIO builds)
+
+#define _GNU_SOURCE
+#include "vita_host.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// sys/stat.h names the seconds of struct stat times st_?time, which would hide SceIoStat fields
+#undef st_ctime
+#undef st_atime
+#undef st_mtime
+
+#define HOST_ERROR ((int)0x80010002)
+
+static int HostFlags(int iFlags)
+{
+    int flags = (SCE_O_RDWR == (iFlags & SCE_O_RDWR)) ? O_RDWR : ((iFlags & SCE_O_WRONLY) ? O_WRONLY : O_RDONLY);
+    if (iFlags & SCE_O_APPEND) flags |= O_APPEND;
+    if (iFlags & SCE_O_CREAT) flags |= O_CREAT;
+    if (iFlags & SCE_O_TRUNC) flags |= O_TRUNC;
+    return flags;
+}
+
+static int HostResult(int iRes)
+{
+    return (iRes < 0) ? HOST_ERROR : iRes;
+}
+
+// File descriptors are offset so that 0 is never a valid one, like Vita UIDs
+#define FD_OFFSET 0x1000
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode)
+{
+    char path[512];
+    int fd = open(hostPath(file, path, sizeof(path)), HostFlags(flags), mode);
+    return (fd < 0) ? HOST_ERROR : fd + FD_OFFSET;
+}
+
+int sceIoClose(SceUID fd)
+{
+    return HostResult(close(fd - FD_OFFSET));
+}
+
+int sceIoRead(SceUID fd, void *data, SceSize size)
+{
+    return HostResult(read(fd - FD_OFFSET, data, size));
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size)
+{
+    return HostResult(write(fd - FD_OFFSET, data, size));
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence)
+{
+    off_t res = lseek(fd - FD_OFFSET, offset, (SCE_SEEK_END == whence) ? SEEK_END : ((SCE_SEEK_CUR == whence) ? SEEK_CUR : SEEK_SET));
+    return (res < 0) ? HOST_ERROR : res;
+}
+
+int sceIoRemove(const char *file)
+{
+    char path[512];
+    return HostResult(unlink(hostPath(file, path, sizeof(path))));
+}
+
+int sceIoMkdir(const char *dir, SceMode mode)
+{
+    char path[512];
+    return HostResult(mkdir(hostPath(dir, path, sizeof(path)), mode));
+}
+
+static void HostTime(const struct timespec* iTime, SceDateTime* oTime)
+{
+    struct tm tm;
+    gmtime_r(&iTime->tv_sec, &tm);
+    oTime->year = tm.tm_year + 1900;
+    oTime->month = tm.tm_mon + 1;
+    oTime->day = tm.tm_mday;
+    oTime->hour = tm.tm_hour;
+    oTime->minute = tm.tm_min;
+    oTime->second = tm.tm_sec;
+    oTime->microsecond = iTime->tv_nsec/1000;
+}
+
+static void HostStat(const struct stat* iStat, SceIoStat* oStat)
+{
+    memset(oStat, 0, sizeof(SceIoStat));
+    oStat->st_mode = iStat->st_mode;
+    oStat->st_size = iStat->st_size;
+    HostTime(&iStat->st_ctim, &oStat->st_ctime);
+    HostTime(&iStat->st_atim, &oStat->st_atime);
+    HostTime(&iStat->st_mtim, &oStat->st_mtime);
+}
+
+int sceIoGetstat(const char *file, SceIoStat *stat)
+{
+    char path[512];
+    struct stat hostStat;
+    if (0 != lstat(hostPath(file, path, sizeof(path)), &hostStat))
+        return HOST_ERROR;
+    HostStat(&hostStat, stat);
+    return 0;
+}
+
+int sceIoGetstatByFd(SceUID fd, SceIoStat *stat)
+{
+    struct stat hostStat;
+    if (0 != fstat(fd - FD_OFFSET, &hostStat))
+        return HOST_ERROR;
+    HostStat(&hostStat, stat);
+    return 0;
+}
+
+#define MAX_DIRS 8
+static DIR* dirs[MAX_DIRS];
+
+SceUID sceIoDopen(const char *dirname)
+{
+    char path[512];
+    for (int i = 0; i < MAX_DIRS; i++)
+    {
+        if (NULL == dirs[i])
+        {
+            dirs[i] = opendir(hostPath(dirname, path, sizeof(path)));
+            return (NULL == dirs[i]) ? HOST_ERROR : i + FD_OFFSET;
+        }
+    }
+    return HOST_ERROR;
+}
+
+// Returns 1 for an entry and 0 at the end, "." and ".." are skipped like on the memory card
+int sceIoDread(SceUID fd, SceIoDirent *dir)
+{
+    if ((unsigned int)(fd - FD_OFFSET) >= MAX_DIRS || NULL == dirs[fd - FD_OFFSET])
+        return HOST_ERROR;
+    struct dirent* entry;
+    do
+    {
+        entry = readdir(dirs[fd - FD_OFFSET]);
+    } while (NULL != entry && (0 == strcmp(entry->d_name, ".") || 0 == strcmp(entry->d_name, "..")));
+    if (NULL == entry)
+        return 0;
+    memset(dir, 0, sizeof(SceIoDirent));
+    snprintf(dir->d_name, sizeof(dir->d_name), "%s", entry->d_name);
+    return 1;
+}
+
+int sceIoDclose(SceUID fd)
+{
+    if ((unsigned int)(fd - FD_OFFSET) >= MAX_DIRS || NULL == dirs[fd - FD_OFFSET])
+        return HOST_ERROR;
+    closedir(dirs[fd - FD_OFFSET]);
+    dirs[fd - FD_OFFSET] = NULL;
+    return 0;
+}
@@ -0,0 +1,35 @@
+// Host implementation of the kuio functions declared in vita_host.h (only linked in READ_WITH_KUIO builds)
+
+#include "vita_host.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define HOST_ERROR ((int)0x80010002)
+#define FD_OFFSET 0x1000
+
+// Read only, like the plugin uses it
+int kuIoOpen(const char *file, int flags, SceUID *res)
+{
+    char path[512];
+    int fd = open(hostPath(file, path, sizeof(path)), O_RDONLY);
+    *res = (fd < 0) ? HOST_ERROR : fd + FD_OFFSET;
+    return (fd < 0) ? HOST_ERROR : 0;
+}
+
+int kuIoClose(SceUID fd)
+{
+    return (close(fd - FD_OFFSET) < 0) ? HOST_ERROR : 0;
+}
+
+int kuIoRead(SceUID fd, void *data, SceSize size)
+{
+    int res = read(fd - FD_OFFSET, data, size);
+    return (res < 0) ? HOST_ERROR : res;
+}
+
+int kuIoLseek(SceUID fd, int offset, int whence)
+{
+    off_t res = lseek(fd - FD_OFFSET, offset, (SCE_SEEK_END == whence) ? SEEK_END : ((SCE_SEEK_CUR == whence) ? SEEK_CUR : SEEK_SET));
+    return (res < 0) ? HOST_ERROR : (int)res;
+}
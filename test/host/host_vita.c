@@ -0,0 +1,410 @@
+// Host implementation of the kernel, taiHEN and DSMotion functions declared in vita_host.h, and of the host paths
+
+#define _GNU_SOURCE
+#include "vita_host.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_ERROR ((int)0x80010002)
+
+// Kernel objects (memory blocks, threads, semaphores and mutexes) share one table of UIDs
+
+#define MAX_OBJECTS 256
+
+enum { OBJECT_FREE, OBJECT_MEMBLOCK, OBJECT_THREAD, OBJECT_SEMA, OBJECT_MUTEX };
+
+typedef struct {
+    int type;
+    void* memory;
+    SceKernelThreadEntry entry;
+    pthread_t thread;
+    int started;
+    int selfDeleted;
+    void* args;
+    SceSize argSize;
+    int exitStatus;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+    int maxCount;
+    pthread_t owner;
+} HostObject;
+
+static HostObject objects[MAX_OBJECTS];
+static pthread_mutex_t objectsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// UIDs are positive, index 0 is never used
+static SceUID NewObject(int iType)
+{
+    pthread_mutex_lock(&objectsLock);
+    for (int i = 1; i < MAX_OBJECTS; i++)
+    {
+        if (OBJECT_FREE == objects[i].type)
+        {
+            memset(&objects[i], 0, sizeof(HostObject));
+            objects[i].type = iType;
+            pthread_mutex_unlock(&objectsLock);
+            return i;
+        }
+    }
+    pthread_mutex_unlock(&objectsLock);
+    return HOST_ERROR;
+}
+
+static HostObject* GetObject(SceUID iUID, int iType)
+{
+    if (iUID <= 0 || iUID >= MAX_OBJECTS || objects[iUID].type != iType)
+        return NULL;
+    return &objects[iUID];
+}
+
+static void DeleteObject(HostObject* ioObject)
+{
+    pthread_mutex_lock(&objectsLock);
+    ioObject->type = OBJECT_FREE;
+    pthread_mutex_unlock(&objectsLock);
+}
+
+SceUID sceKernelAllocMemBlock(const char *name, SceUInt32 type, SceSize size, void *optp)
+{
+    if (0 == size || (size & 0xFFF))
+        return HOST_ERROR;
+    void* memory = NULL;
+    if (0 != posix_memalign(&memory, 4096, size))
+        return HOST_ERROR;
+    SceUID uid = NewObject(OBJECT_MEMBLOCK);
+    if (uid < 0)
+    {
+        free(memory);
+        return uid;
+    }
+    objects[uid].memory = memory;
+    return uid;
+}
+
+int sceKernelFreeMemBlock(SceUID uid)
+{
+    HostObject* object = GetObject(uid, OBJECT_MEMBLOCK);
+    if (NULL == object)
+        return HOST_ERROR;
+    free(object->memory);
+    DeleteObject(object);
+    return 0;
+}
+
+int sceKernelGetMemBlockBase(SceUID uid, void **basep)
+{
+    HostObject* object = GetObject(uid, OBJECT_MEMBLOCK);
+    if (NULL == object)
+        return HOST_ERROR;
+    *basep = object->memory;
+    return 0;
+}
+
+int hostMemBlockCount(void)
+{
+    int count = 0;
+    for (int i = 1; i < MAX_OBJECTS; i++)
+        count += (OBJECT_MEMBLOCK == objects[i].type);
+    return count;
+}
+
+// Threads
+
+static __thread SceUID currentThread = 0;
+static int runningThreads = 0;
+
+static void* ThreadMain(void* iArg)
+{
+    SceUID uid = (SceUID)(intptr_t)iArg;
+    currentThread = uid;
+    objects[uid].exitStatus = objects[uid].entry(objects[uid].argSize, objects[uid].args);
+    __sync_fetch_and_sub(&runningThreads, 1);
+    return NULL;
+}
+
+int hostThreadCount(void)
+{
+    return __sync_fetch_and_add(&runningThreads, 0);
+}
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority, int stackSize, SceUInt attr, int cpuAffinityMask, const void *option)
+{
+    SceUID uid = NewObject(OBJECT_THREAD);
+    if (uid >= 0)
+        objects[uid].entry = entry;
+    return uid;
+}
+
+// Arguments are copied like the kernel copies them to the new thread stack
+int sceKernelStartThread(SceUID thid, SceSize arglen, void *argp)
+{
+    HostObject* object = GetObject(thid, OBJECT_THREAD);
+    if (NULL == object || object->started)
+        return HOST_ERROR;
+    object->args = NULL;
+    object->argSize = arglen;
+    __sync_fetch_and_add(&runningThreads, 1);
+    if (arglen > 0)
+    {
+        object->args = malloc(arglen);
+        memcpy(object->args, argp, arglen);
+    }
+    if (0 != pthread_create(&object->thread, NULL, &ThreadMain, (void*)(intptr_t)thid))
+    {
+        __sync_fetch_and_sub(&runningThreads, 1);
+        free(object->args);
+        return HOST_ERROR;
+    }
+    object->started = 1;
+    return 0;
+}
+
+int sceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout)
+{
+    HostObject* object = GetObject(thid, OBJECT_THREAD);
+    if (NULL == object || !object->started || object->selfDeleted)
+        return HOST_ERROR;
+    if (object->started > 0)
+    {
+        pthread_join(object->thread, NULL);
+        object->started = -1;
+    }
+    if (NULL != stat)
+        *stat = object->exitStatus;
+    return 0;
+}
+
+int sceKernelDeleteThread(SceUID thid)
+{
+    HostObject* object = GetObject(thid, OBJECT_THREAD);
+    if (NULL == object || object->started > 0)
+        return HOST_ERROR;
+    free(object->args);
+    DeleteObject(object);
+    return 0;
+}
+
+int sceKernelExitDeleteThread(int status)
+{
+    HostObject* object = GetObject(currentThread, OBJECT_THREAD);
+    if (NULL != object)
+    {
+        object->selfDeleted = 1;
+        pthread_detach(object->thread);
+        free(object->args);
+        DeleteObject(object);
+    }
+    __sync_fetch_and_sub(&runningThreads, 1);
+    pthread_exit(NULL);
+    return 0;
+}
+
+static __thread int delayCount = 0;
+
+int hostDelayCount(void)
+{
+    return delayCount;
+}
+
+int sceKernelDelayThread(SceUInt delay)
+{
+    __sync_fetch_and_add(&delayCount, 1);
+    struct timespec time = { delay/1000000, (delay%1000000)*1000 };
+    while (0 != nanosleep(&time, &time) && EINTR == errno)
+        ;
+    return 0;
+}
+
+// Semaphores and mutexes
+
+static void InitSync(HostObject* oObject, int iCount)
+{
+    pthread_mutex_init(&oObject->lock, NULL);
+    pthread_cond_init(&oObject->cond, NULL);
+    oObject->count = iCount;
+}
+
+static void DestroySync(HostObject* ioObject)
+{
+    pthread_mutex_destroy(&ioObject->lock);
+    pthread_cond_destroy(&ioObject->cond);
+    DeleteObject(ioObject);
+}
+
+// Waits until ioObject->count >= iCount (lock held), returns 0 or SCE_KERNEL_ERROR_WAIT_TIMEOUT
+static int WaitCount(HostObject* ioObject, int iCount, SceUInt* iTimeout)
+{
+    struct timespec deadline;
+    if (NULL != iTimeout)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        uint64_t ns = (uint64_t)deadline.tv_nsec + (uint64_t)*iTimeout*1000;
+        deadline.tv_sec += ns/1000000000;
+        deadline.tv_nsec = ns%1000000000;
+    }
+    while (ioObject->count < iCount)
+    {
+        if (NULL == iTimeout)
+            pthread_cond_wait(&ioObject->cond, &ioObject->lock);
+        else if (ETIMEDOUT == pthread_cond_timedwait(&ioObject->cond, &ioObject->lock, &deadline))
+            return SCE_KERNEL_ERROR_WAIT_TIMEOUT;
+    }
+    return 0;
+}
+
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int initVal, int maxVal, void *option)
+{
+    SceUID uid = NewObject(OBJECT_SEMA);
+    if (uid >= 0)
+    {
+        InitSync(&objects[uid], initVal);
+        objects[uid].maxCount = maxVal;
+    }
+    return uid;
+}
+
+int sceKernelDeleteSema(SceUID semaid)
+{
+    HostObject* object = GetObject(semaid, OBJECT_SEMA);
+    if (NULL == object)
+        return HOST_ERROR;
+    DestroySync(object);
+    return 0;
+}
+
+int sceKernelSignalSema(SceUID semaid, int signal)
+{
+    HostObject* object = GetObject(semaid, OBJECT_SEMA);
+    if (NULL == object)
+        return HOST_ERROR;
+    pthread_mutex_lock(&object->lock);
+    int res = (object->count + signal > object->maxCount) ? HOST_ERROR : 0;
+    if (0 == res)
+    {
+        object->count += signal;
+        pthread_cond_broadcast(&object->cond);
+    }
+    pthread_mutex_unlock(&object->lock);
+    return res;
+}
+
+int sceKernelWaitSema(SceUID semaid, int signal, SceUInt *timeout)
+{
+    HostObject* object = GetObject(semaid, OBJECT_SEMA);
+    if (NULL == object)
+        return HOST_ERROR;
+    pthread_mutex_lock(&object->lock);
+    int res = WaitCount(object, signal, timeout);
+    if (0 == res)
+        object->count -= signal;
+    pthread_mutex_unlock(&object->lock);
+    return res;
+}
+
+// count is 1 when the mutex is free, the owner may lock it again (lockCount is ignored)
+SceUID sceKernelCreateMutex(const char *name, SceUInt attr, int initCount, void *option)
+{
+    SceUID uid = NewObject(OBJECT_MUTEX);
+    if (uid >= 0)
+        InitSync(&objects[uid], 1);
+    return uid;
+}
+
+int sceKernelDeleteMutex(SceUID mutexid)
+{
+    HostObject* object = GetObject(mutexid, OBJECT_MUTEX);
+    if (NULL == object)
+        return HOST_ERROR;
+    DestroySync(object);
+    return 0;
+}
+
+int sceKernelLockMutex(SceUID mutexid, int lockCount, unsigned int *timeout)
+{
+    HostObject* object = GetObject(mutexid, OBJECT_MUTEX);
+    if (NULL == object)
+        return HOST_ERROR;
+    pthread_mutex_lock(&object->lock);
+    if (object->count <= 0 && pthread_equal(object->owner, pthread_self()))
+        object->count--;
+    else
+    {
+        WaitCount(object, 1, NULL);
+        object->count = 0;
+        object->owner = pthread_self();
+    }
+    pthread_mutex_unlock(&object->lock);
+    return 0;
+}
+
+int sceKernelUnlockMutex(SceUID mutexid, int unlockCount)
+{
+    HostObject* object = GetObject(mutexid, OBJECT_MUTEX);
+    if (NULL == object)
+        return HOST_ERROR;
+    pthread_mutex_lock(&object->lock);
+    if (++object->count > 0)
+    {
+        object->count = 1;
+        pthread_cond_broadcast(&object->cond);
+    }
+    pthread_mutex_unlock(&object->lock);
+    return 0;
+}
+
+SceUInt64 sceKernelGetProcessTimeWide(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (SceUInt64)now.tv_sec*1000000 + now.tv_nsec/1000;
+}
+
+int sceAppMgrAppParamGetString(int pid, int param, char *string, int length)
+{
+    snprintf(string, length, "HOST00000");
+    return 0;
+}
+
+// File system
+
+static char hostRoot[256] = "ux0";
+
+void hostSetRoot(const char* iRoot)
+{
+    snprintf(hostRoot, sizeof(hostRoot), "%s", iRoot);
+}
+
+const char* hostPath(const char* iPath, char* oPath, size_t iSize)
+{
+    if (0 != strncmp(iPath, "ux0:", 4))
+        return iPath;
+    iPath += 4;
+    while ('/' == *iPath)
+        iPath++;
+    snprintf(oPath, iSize, "%s/%s", hostRoot, iPath);
+    return oPath;
+}
+
+// taiHEN and DSMotion
+
+SceUID taiHookFunctionImport(tai_hook_ref_t *p_hook, const char *module, uint32_t library_nid, uint32_t func_nid, const void *hook_func)
+{
+    *p_hook = 0;
+    return HOST_ERROR;
+}
+
+int taiHookRelease(SceUID tai_uid, tai_hook_ref_t hook)
+{
+    return HOST_ERROR;
+}
+
+int dsGetSampledAccelGyro(int samples, signed short accel[3], signed short gyro[3])
+{
+    return HOST_ERROR;
+}
@@ -0,0 +1,2 @@
+// Host build stand-in, see vita_host.h
+#include "../vita_host.h"
@@ -0,0 +1,229 @@
+// Host stand-in for the parts of VITASDK, taiHEN, kuio and DSMotion used by main.c
+// Every SDK header included by main.c forwards here, so main.c builds unchanged for host tests and benchmarks
+// Kernel objects are backed by pthreads and heap memory, file paths starting with "ux0:" are mapped to a host directory
+
+#ifndef VITA_HOST_H
+#define VITA_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int SceUID;
+typedef unsigned int SceSize;
+typedef unsigned int SceUInt;
+typedef unsigned int SceUInt32;
+typedef uint64_t SceUInt64;
+typedef int64_t SceOff;
+typedef int SceMode;
+
+// Host helpers (host_vita.c)
+
+// Directory standing for "ux0:" ("ux0" in the current directory by default)
+void hostSetRoot(const char* iRoot);
+// Host path of a Vita path (paths which don't start with "ux0:" are kept as they are)
+const char* hostPath(const char* iPath, char* oPath, size_t iSize);
+// Memory blocks currently allocated
+int hostMemBlockCount(void);
+// Threads started and not returned yet
+int hostThreadCount(void);
+// sceKernelDelayThread calls of the calling thread so far
+int hostDelayCount(void);
+
+// Kernel
+
+#define SCE_KERNEL_START_SUCCESS 0
+#define SCE_KERNEL_STOP_SUCCESS  0
+
+#define SCE_KERNEL_MEMBLOCK_TYPE_USER_RW 0x0C20D060
+
+#define SCE_KERNEL_ERROR_WAIT_TIMEOUT 0x80028005
+
+typedef int (*SceKernelThreadEntry)(SceSize args, void *argp);
+
+SceUID sceKernelAllocMemBlock(const char *name, SceUInt32 type, SceSize size, void *optp);
+int sceKernelFreeMemBlock(SceUID uid);
+int sceKernelGetMemBlockBase(SceUID uid, void **basep);
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority, int stackSize, SceUInt attr, int cpuAffinityMask, const void *option);
+int sceKernelStartThread(SceUID thid, SceSize arglen, void *argp);
+int sceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout);
+int sceKernelDeleteThread(SceUID thid);
+int sceKernelExitDeleteThread(int status);
+int sceKernelDelayThread(SceUInt delay);
+
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int initVal, int maxVal, void *option);
+int sceKernelDeleteSema(SceUID semaid);
+int sceKernelSignalSema(SceUID semaid, int signal);
+int sceKernelWaitSema(SceUID semaid, int signal, SceUInt *timeout);
+
+SceUID sceKernelCreateMutex(const char *name, SceUInt attr, int initCount, void *option);
+int sceKernelDeleteMutex(SceUID mutexid);
+int sceKernelLockMutex(SceUID mutexid, int lockCount, unsigned int *timeout);
+int sceKernelUnlockMutex(SceUID mutexid, int unlockCount);
+
+SceUInt64 sceKernelGetProcessTimeWide(void);
+
+int sceAppMgrAppParamGetString(int pid, int param, char *string, int length);
+
+// File system
+
+#define SCE_O_RDONLY 0x0001
+#define SCE_O_WRONLY 0x0002
+#define SCE_O_RDWR   (SCE_O_RDONLY|SCE_O_WRONLY)
+#define SCE_O_APPEND 0x0100
+#define SCE_O_CREAT  0x0200
+#define SCE_O_TRUNC  0x0400
+
+#define SCE_SEEK_SET 0
+#define SCE_SEEK_CUR 1
+#define SCE_SEEK_END 2
+
+typedef struct SceDateTime {
+    unsigned short year;
+    unsigned short month;
+    unsigned short day;
+    unsigned short hour;
+    unsigned short minute;
+    unsigned short second;
+    unsigned int microsecond;
+} SceDateTime;
+
+typedef struct SceIoStat {
+    SceMode st_mode;
+    unsigned int st_attr;
+    SceOff st_size;
+    SceDateTime st_ctime;
+    SceDateTime st_atime;
+    SceDateTime st_mtime;
+    unsigned int st_private[6];
+} SceIoStat;
+
+typedef struct SceIoDirent {
+    SceIoStat d_stat;
+    char d_name[256];
+    void *d_private;
+    int dummy;
+} SceIoDirent;
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode);
+int sceIoClose(SceUID fd);
+int sceIoRead(SceUID fd, void *data, SceSize size);
+int sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+int sceIoRemove(const char *file);
+int sceIoMkdir(const char *dir, SceMode mode);
+int sceIoGetstat(const char *file, SceIoStat *stat);
+int sceIoGetstatByFd(SceUID fd, SceIoStat *stat);
+SceUID sceIoDopen(const char *dirname);
+int sceIoDread(SceUID fd, SceIoDirent *dir);
+int sceIoDclose(SceUID fd);
+
+// kuio (host_kuio.c, only linked in READ_WITH_KUIO builds so that they can't use sceIo functions)
+
+int kuIoOpen(const char *file, int flags, SceUID *res);
+int kuIoClose(SceUID fd);
+int kuIoRead(SceUID fd, void *data, SceSize size);
+int kuIoLseek(SceUID fd, int offset, int whence);
+
+// Camera
+
+typedef enum SceCameraFormat {
+    SCE_CAMERA_FORMAT_INVALID       = 0,
+    SCE_CAMERA_FORMAT_YUV422_PLANE  = 1,
+    SCE_CAMERA_FORMAT_YUV422_PACKED = 2,
+    SCE_CAMERA_FORMAT_YUV420_PLANE  = 3,
+    SCE_CAMERA_FORMAT_ABGR          = 4,
+    SCE_CAMERA_FORMAT_ARGB          = 5,
+    SCE_CAMERA_FORMAT_RAW8          = 6
+} SceCameraFormat;
+
+typedef enum SceCameraResolution {
+    SCE_CAMERA_RESOLUTION_0_0     = 0,
+    SCE_CAMERA_RESOLUTION_640_480 = 1,
+    SCE_CAMERA_RESOLUTION_320_240 = 2,
+    SCE_CAMERA_RESOLUTION_160_120 = 3,
+    SCE_CAMERA_RESOLUTION_352_288 = 4,
+    SCE_CAMERA_RESOLUTION_176_144 = 5,
+    SCE_CAMERA_RESOLUTION_480_272 = 6,
+    SCE_CAMERA_RESOLUTION_640_360 = 8
+} SceCameraResolution;
+
+typedef enum SceCameraFrameRate {
+    SCE_CAMERA_FRAMERATE_3_FPS   = 3,
+    SCE_CAMERA_FRAMERATE_5_FPS   = 5,
+    SCE_CAMERA_FRAMERATE_7_FPS   = 7,
+    SCE_CAMERA_FRAMERATE_10_FPS  = 10,
+    SCE_CAMERA_FRAMERATE_15_FPS  = 15,
+    SCE_CAMERA_FRAMERATE_20_FPS  = 20,
+    SCE_CAMERA_FRAMERATE_30_FPS  = 30,
+    SCE_CAMERA_FRAMERATE_60_FPS  = 60,
+    SCE_CAMERA_FRAMERATE_120_FPS = 120
+} SceCameraFrameRate;
+
+#define SCE_CAMERA_SATURATION_0     0
+#define SCE_CAMERA_SHARPNESS_100    1
+#define SCE_CAMERA_REVERSE_OFF      0
+#define SCE_CAMERA_EFFECT_NORMAL    0
+#define SCE_CAMERA_EV_POSITIVE_0    0
+#define SCE_CAMERA_ANTIFLICKER_AUTO 1
+#define SCE_CAMERA_ISO_AUTO         1
+#define SCE_CAMERA_GAIN_AUTO        0
+#define SCE_CAMERA_WB_AUTO          0
+#define SCE_CAMERA_BACKLIGHT_OFF    0
+#define SCE_CAMERA_NIGHTMODE_OFF    0
+
+typedef struct SceCameraInfo {
+    SceSize size;
+    uint16_t priority;
+    uint16_t format;
+    uint16_t resolution;
+    uint16_t framerate;
+    uint16_t width;
+    uint16_t height;
+    uint16_t range;
+    uint16_t pad;
+    SceSize sizeIBase;
+    SceSize sizeUBase;
+    SceSize sizeVBase;
+    void *pIBase;
+    void *pUBase;
+    void *pVBase;
+    uint16_t pitch;
+    uint16_t buffer;
+} SceCameraInfo;
+
+typedef struct SceCameraRead {
+    SceSize size;
+    int mode;
+    int pad;
+    int status;
+    uint64_t frame;
+    uint64_t timestamp;
+    SceSize sizeIBase;
+    SceSize sizeUBase;
+    SceSize sizeVBase;
+    void *pIBase;
+    void *pUBase;
+    void *pVBase;
+} SceCameraRead;
+
+typedef struct SceFVector3 {
+    float x, y, z;
+} SceFVector3;
+
+// taiHEN: no hook is installed, so every original SceCamera function fails like on a device without camera
+
+typedef uintptr_t tai_hook_ref_t;
+
+#define TAI_MAIN_MODULE ((const char*)0)
+#define HOST_CAMERA_ERROR ((int)0x802E0001)
+#define TAI_CONTINUE(type, hook, ...) ((type)HOST_CAMERA_ERROR)
+
+SceUID taiHookFunctionImport(tai_hook_ref_t *p_hook, const char *module, uint32_t library_nid, uint32_t func_nid, const void *hook_func);
+int taiHookRelease(SceUID tai_uid, tai_hook_ref_t hook);
+
+// DSMotion: no motion sensor
+
+int dsGetSampledAccelGyro(int samples, signed short accel[3], signed short gyro[3]);
+
+#endif
@@ -0,0 +1,697 @@
+// Host tests of main.c
+// Usage: fakecamera_tests DATA_DIR [--update-golden] [--max-slowdown FACTOR] [--trace-out PATH] [--golden-only]
+//
+// Golden images: every BMP of DATA_DIR is loaded through LoadBMPFile in each camera format (with several "loadChunkRows"
+// values, BMP pixels kept or streamed) and its planes must match DATA_DIR/golden/NAME_FORMAT.bin byte for byte
+// Conversion time: generated 320x240 images are loaded in each format, and the best time of several loads relative to a
+// reference loop (so that results don't depend on the machine speed) must not exceed DATA_DIR/golden/timings.csv by more
+// than FACTOR (not checked without --max-slowdown)
+// Truncated images: BMP files cut in their pixels must fail to load
+// Image cache: cached RAW8 images must match the Bayer pattern setting
+// Image index: files of other titles must not keep the image directory from being indexed, stale entries must not hide
+// other image files
+// YUV conversion: fixed-point results must stay within 1 of the former float matrix
+// Y4M color spaces: only 8 bits 4:2:0 ones are accepted
+// Frame clock: exact frame starts for every frame rate, then camera reads through the hooks with the virtual clock
+// ("virtualClock" setting, reproducible frame numbers and time stamps) and with the process time
+// Trace: camera events of these reads must all be in "trace.bin" ("trace" setting), which --trace-out copies to PATH
+// --update-golden writes missing BMP fixtures, golden planes and timings from the current code
+// --golden-only runs the golden images and YUV conversion tests only (NEON builds checked against the scalar results)
+
+#include "main.c"
+#include "testutil.h"
+
+static const SceCameraFormat testFormats[] = {
+    SCE_CAMERA_FORMAT_ARGB, SCE_CAMERA_FORMAT_ABGR, SCE_CAMERA_FORMAT_YUV422_PACKED,
+    SCE_CAMERA_FORMAT_YUV422_PLANE, SCE_CAMERA_FORMAT_YUV420_PLANE, SCE_CAMERA_FORMAT_RAW8 };
+
+#define NB_TEST_FORMATS (sizeof(testFormats)/sizeof(testFormats[0]))
+
+// BMP fixtures: every depth with odd widths and heights, and 32 bits images read straight into ARGB/ABGR planes
+static const struct {
+    const char* name;
+    unsigned int width;
+    unsigned int height;
+    unsigned int bits;
+} fixtures[] = {
+    { "bgr16_34x26", 34, 26, 16 },
+    { "bgr16_35x27", 35, 27, 16 },
+    { "bgr24_33x25", 33, 25, 24 },
+    { "bgr24_64x48", 64, 48, 24 },
+    { "bgr32_31x23", 31, 23, 32 },
+    { "bgr32_32x24", 32, 24, 32 },
+};
+
+static const int chunkRows[] = { 2, 6, 32, 512 };
+
+static const char* dataDir = NULL;
+static int updateGolden = 0;
+static double maxSlowdown = 0.;
+static const char* traceOut = NULL;
+static int goldenOnly = 0;
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+// Planes of an image in a single buffer
+static unsigned char* ImagePlanes(const ImageBuffers* iBuffers, unsigned int* oSize)
+{
+    unsigned int size = 0;
+    for (int i = 0; i < 3; i++)
+        size += PlaneSize(iBuffers, i);
+    unsigned char* planes = malloc(size ? size : 1);
+    unsigned int offset = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        memcpy(planes + offset, iBuffers->blocksData[i], PlaneSize(iBuffers, i));
+        offset += PlaneSize(iBuffers, i);
+    }
+    *oSize = size;
+    return planes;
+}
+
+static unsigned char* ReadWholeFile(const char* iPath, unsigned int* oSize)
+{
+    FILE* file = fopen(iPath, "rb");
+    if (NULL == file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* data = malloc(size > 0 ? size : 1);
+    if (size < 0 || (size > 0 && 1 != fread(data, size, 1, file)))
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *oSize = (unsigned int)size;
+    return data;
+}
+
+static int WriteWholeFile(const char* iPath, const void* iData, unsigned int iSize)
+{
+    FILE* file = fopen(iPath, "wb");
+    if (NULL == file)
+        return -1;
+    int res = (0 == iSize || 1 == fwrite(iData, iSize, 1, file)) ? 0 : -1;
+    return (0 == fclose(file)) ? res : -1;
+}
+
+static void TestGoldenImages(void)
+{
+    char path[256];
+    char goldenPath[256];
+    snprintf(path, sizeof(path), "%s/golden", dataDir);
+    mkdir(path, 0777);
+
+    for (int i = 0; i < sizeof(fixtures)/sizeof(fixtures[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s.bmp", dataDir, fixtures[i].name);
+        if (updateGolden && 0 != access(path, F_OK))
+            WriteTestBMP(path, fixtures[i].width, fixtures[i].height, fixtures[i].bits, i+1);
+
+        for (int f = 0; f < NB_TEST_FORMATS; f++)
+        {
+            snprintf(goldenPath, sizeof(goldenPath), "%s/golden/%s_%s.bin", dataDir, fixtures[i].name, FormatName(testFormats[f]));
+            unsigned int goldenSize = 0;
+            unsigned char* golden = updateGolden ? NULL : ReadWholeFile(goldenPath, &goldenSize);
+            CHECK(updateGolden || NULL != golden, "missing %s", goldenPath);
+
+            // Odd indexes stream BMP pixels through a chunk of rows ("imageMemoryLimit" too low to keep them)
+            for (int c = 0; c < 2*sizeof(chunkRows)/sizeof(chunkRows[0]); c++)
+            {
+                config.loadChunkRows = chunkRows[c/2];
+                config.imageMemoryLimit = (c & 1) ? 0 : 4096;
+                BitmapPixels pixels;
+                ImageBuffers buffers;
+                LoadStats stats;
+                int res = LoadTestImage(path, testFormats[f], &pixels, &buffers, &stats);
+                CHECK(res >= 0, "%s as %s with %d rows chunks%s: load failed", fixtures[i].name, FormatName(testFormats[f]), chunkRows[c/2], (c & 1) ? " streamed" : "");
+                CHECK(!(c & 1) || NULL == pixels.data, "%s as %s: BMP pixels kept beyond the memory limit", fixtures[i].name, FormatName(testFormats[f]));
+                if (res < 0)
+                    continue;
+
+                unsigned int size;
+                unsigned char* planes = ImagePlanes(&buffers, &size);
+                if (updateGolden && NULL == golden)
+                {
+                    CHECK(0 == WriteWholeFile(goldenPath, planes, size), "can't write %s", goldenPath);
+                    golden = ReadWholeFile(goldenPath, &goldenSize);
+                }
+                else if (NULL != golden)
+                {
+                    unsigned int diff = 0;
+                    while (diff < size && diff < goldenSize && planes[diff] == golden[diff])
+                        diff++;
+                    CHECK(size == goldenSize && diff == size, "%s as %s with %d rows chunks%s: %u bytes instead of %u, first difference at %u",
+                          fixtures[i].name, FormatName(testFormats[f]), chunkRows[c/2], (c & 1) ? " streamed" : "", size, goldenSize, diff);
+                }
+                free(planes);
+                FreeBitmapPixels(&pixels);
+                FreeImageBuffers(&buffers);
+            }
+            free(golden);
+        }
+    }
+    config.loadChunkRows = 32;
+    config.imageMemoryLimit = 0;
+}
+
+// BMP files cut in the middle of their pixels must fail to load (read straight into planes or through the pipeline),
+// without keeping their pixels
+static void TestTruncatedImages(void)
+{
+    static const unsigned int bits[] = { 24, 32 };
+    char path[128];
+    snprintf(path, sizeof(path), "%s/data/FakeCamera/truncated.bmp", tempRoot);
+    for (int b = 0; b < sizeof(bits)/sizeof(bits[0]); b++)
+    {
+        struct stat fileStat;
+        if (WriteTestBMP(path, 64, 48, bits[b], 3) < 0 || stat(path, &fileStat) < 0 || truncate(path, fileStat.st_size - 64*bits[b]/8*10) < 0)
+        {
+            CHECK(0, "can't write %s", path);
+            continue;
+        }
+        for (int f = 0; f < NB_TEST_FORMATS; f++)
+        {
+            for (int c = 0; c < sizeof(chunkRows)/sizeof(chunkRows[0]); c++)
+            {
+                config.loadChunkRows = chunkRows[c];
+                BitmapPixels pixels;
+                ImageBuffers buffers;
+                LoadStats stats;
+                int res = LoadTestImage(path, testFormats[f], &pixels, &buffers, &stats);
+                CHECK(res < 0 && NULL == pixels.data, "truncated %u bits BMP as %s with %d rows chunks: loaded", bits[b], FormatName(testFormats[f]), chunkRows[c]);
+                FreeBitmapPixels(&pixels);
+                FreeImageBuffers(&buffers);
+            }
+        }
+    }
+    remove(path);
+    config.loadChunkRows = 32;
+}
+
+#ifndef READ_WITH_KUIO
+// RAW8 images in the converted images cache are only reused with the Bayer pattern they were converted with
+static void TestImageCacheKey(void)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/data/FakeCamera/cached.bmp", tempRoot);
+    if (WriteTestBMP(path, 64, 48, 24, 5) < 0)
+    {
+        CHECK(0, "can't write %s", path);
+        return;
+    }
+    static const int patterns[] = { BAYER_PATTERN_RGGB, BAYER_PATTERN_GRBG, BAYER_PATTERN_GRBG, BAYER_PATTERN_RGGB };
+    unsigned char* planes[sizeof(patterns)/sizeof(patterns[0])] = { NULL };
+    unsigned int size = 0;
+    config.imageCache = 1;
+    config.imageMemoryLimit = 4096;
+    for (int i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++)
+    {
+        config.bayerPattern = patterns[i];
+        BitmapPixels pixels;
+        ImageBuffers buffers;
+        LoadStats stats;
+        if (LoadTestImage(path, SCE_CAMERA_FORMAT_RAW8, &pixels, &buffers, &stats) < 0)
+        {
+            CHECK(0, "RAW8 load %d failed", i);
+            continue;
+        }
+        // Only cached images come without BMP pixels
+        int cached = (NULL == pixels.data);
+        CHECK(cached == (i >= 2), "RAW8 load %d with pattern %d: cache %s", i, patterns[i], cached ? "used" : "not used");
+        planes[i] = ImagePlanes(&buffers, &size);
+        FreeBitmapPixels(&pixels);
+        FreeImageBuffers(&buffers);
+    }
+    if (NULL != planes[0] && NULL != planes[1] && NULL != planes[2] && NULL != planes[3])
+    {
+        CHECK(0 != memcmp(planes[0], planes[1], size), "RAW8 planes don't depend on the Bayer pattern");
+        CHECK(0 == memcmp(planes[1], planes[2], size) && 0 == memcmp(planes[0], planes[3], size), "cached RAW8 planes differ");
+    }
+    for (int i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++)
+        free(planes[i]);
+    remove(path);
+    config.imageCache = 0;
+    config.imageMemoryLimit = 0;
+    config.bayerPattern = BAYER_PATTERN_RGGB;
+}
+#endif
+
+#ifndef READ_WITH_KUIO
+// Images of other titles don't fill the image index, which then keeps being used
+static void TestImageIndex(void)
+{
+    char path[128];
+    for (int i = 0; i < 2*MAX_INDEXED_IMAGES; i++)
+    {
+        snprintf(path, sizeof(path), "%s/data/FakeCamera/PCSX%05d.bmp", tempRoot, i);
+        WriteWholeFile(path, "", 0);
+    }
+    imageIndex.valid = 0;
+    CHECK(UpdateImageIndex() && 1 == imageIndex.count && SameNameNoCase(imageIndex.names[0], "ALL.bmp"), "image index with %d names", imageIndex.count);
+    char imagePath[128];
+    SceUID fd = OpenImageFile(0, imagePath);
+    CHECK(fd >= 0 && 0 == strcmp(imagePath, IMAGE_DIR "/ALL.bmp"), "ALL.bmp not found through the image index");
+    if (fd >= 0)
+        CloseFile(fd);
+
+    // A listed file which can't be opened any more doesn't hide the other image files
+    strcpy(imageIndex.names[imageIndex.count++], "ALL.y4m");
+    fd = OpenImageFile(0, imagePath);
+    CHECK(fd >= 0 && 0 == strcmp(imagePath, IMAGE_DIR "/ALL.bmp") && !imageIndex.valid, "ALL.bmp not found after a stale image index entry");
+    if (fd >= 0)
+        CloseFile(fd);
+    for (int i = 0; i < 2*MAX_INDEXED_IMAGES; i++)
+    {
+        snprintf(path, sizeof(path), "%s/data/FakeCamera/PCSX%05d.bmp", tempRoot, i);
+        remove(path);
+    }
+}
+#endif
+
+// Former float BT.601 matrix, fixed-point results must stay within 1 of its rounded and saturated values
+static const float convMat[3][3] = { {0.299f, 0.587f, 0.114f}, {-0.14317f, -0.28886f, 0.436f}, {0.615f, -0.51499f, -0.10001f} };
+
+// Float Y (iRow 0), U (1) or V (2) of iCount pixels averaged
+static int FloatYUV(int iRow, const int* iR, const int* iG, const int* iB, int iCount)
+{
+    float sum = 0.f;
+    for (int i = 0; i < iCount; i++)
+        sum += convMat[iRow][0]*iR[i] + convMat[iRow][1]*iG[i] + convMat[iRow][2]*iB[i];
+    float val = sum/iCount + ((0 == iRow) ? 0.f : 128.f) + 0.5f;
+    return (val < 0.f) ? 0 : ((val >= 255.f) ? 255 : (int)val);
+}
+
+// main.c abs() macro doesn't take expressions
+static int AbsDiff(int iVal1, int iVal2)
+{
+    return (iVal1 > iVal2) ? iVal1 - iVal2 : iVal2 - iVal1;
+}
+
+static int RandomChannel(uint32_t* ioSeed)
+{
+    *ioSeed = *ioSeed*1664525 + 1013904223;
+    uint32_t bits = *ioSeed >> 8;
+    // Extreme values one time out of four
+    return (0 == (bits & 3)) ? ((bits & 4) ? 255 : 0) : (bits >> 3) & 0xFF;
+}
+
+static void TestYUVConversion(void)
+{
+    // Conversion functions on random pixels, alone (Y) or by groups of 2 and 4 (chroma)
+    uint32_t seed = 1;
+    int maxDiff = 0;
+    for (int n = 0; n < 1000000; n++)
+    {
+        int r[4], g[4], b[4];
+        for (int i = 0; i < 4; i++)
+        {
+            r[i] = RandomChannel(&seed);
+            g[i] = RandomChannel(&seed);
+            b[i] = RandomChannel(&seed);
+        }
+        int diff = AbsDiff(RGBChannelsToY(r[0], g[0], b[0]), FloatYUV(0, r, g, b, 1));
+        for (int shift = 1; shift <= 2; shift++)
+        {
+            int count = 1 << shift;
+            int sumR = 0, sumG = 0, sumB = 0;
+            for (int i = 0; i < count; i++)
+            {
+                sumR += r[i];
+                sumG += g[i];
+                sumB += b[i];
+            }
+            for (int row = 1; row <= 2; row++)
+            {
+                int rowDiff = AbsDiff(RGBSumToUV(row, sumR, sumG, sumB, shift), FloatYUV(row, r, g, b, count));
+                diff = (rowDiff > diff) ? rowDiff : diff;
+            }
+        }
+        maxDiff = (diff > maxDiff) ? diff : maxDiff;
+    }
+    CHECK(maxDiff <= 1, "fixed-point conversion differs by %d from the float matrix", maxDiff);
+
+    // Whole images through the row kernels of every BMP depth (BMP pixels kept to compare with)
+    config.imageMemoryLimit = 4096;
+    static const char* names[] = { "bgr16_35x27", "bgr24_33x25", "bgr32_31x23" };
+    static const SceCameraFormat formats[] = { SCE_CAMERA_FORMAT_YUV422_PACKED, SCE_CAMERA_FORMAT_YUV422_PLANE, SCE_CAMERA_FORMAT_YUV420_PLANE };
+    for (int n = 0; n < sizeof(names)/sizeof(names[0]); n++)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.bmp", dataDir, names[n]);
+        for (int f = 0; f < sizeof(formats)/sizeof(formats[0]); f++)
+        {
+            BitmapPixels pixels;
+            ImageBuffers buffers;
+            LoadStats stats;
+            if (LoadTestImage(path, formats[f], &pixels, &buffers, &stats) < 0 || NULL == pixels.data)
+            {
+                CHECK(0, "%s as %s: load failed", names[n], FormatName(formats[f]));
+                continue;
+            }
+
+            int packed = (SCE_CAMERA_FORMAT_YUV422_PACKED == formats[f]);
+            int pairRows = (SCE_CAMERA_FORMAT_YUV420_PLANE == formats[f]) ? 2 : 1;
+            const unsigned char* planes[3] = { buffers.blocksData[0], buffers.blocksData[1], buffers.blocksData[2] };
+            maxDiff = 0;
+            for (unsigned int y = 0; y < buffers.imageHeight; y += pairRows)
+            {
+                for (unsigned int x = 0; x < buffers.imageWidth; x += 2)
+                {
+                    // Pixels of the chroma sample (image rows are top-down, BMP rows bottom-up)
+                    int r[4], g[4], b[4], a;
+                    for (int i = 0; i < 2*pairRows; i++)
+                    {
+                        const unsigned char* row = pixels.data + (buffers.imageHeight-1-y-i/2)*pixels.rowStride;
+                        ReadPixel(row, pixels.bits, x+(i&1), &r[i], &g[i], &b[i], &a);
+                        const unsigned char* lumaRow = planes[0] + (y+i/2)*buffers.rowStride[0];
+                        int luma = packed ? lumaRow[(x+(i&1))*2+1] : lumaRow[x+(i&1)];
+                        int diff = AbsDiff(luma, FloatYUV(0, &r[i], &g[i], &b[i], 1));
+                        maxDiff = (diff > maxDiff) ? diff : maxDiff;
+                    }
+                    for (int c = 1; c <= 2; c++)
+                    {
+                        int chroma = packed ? planes[0][y*buffers.rowStride[0] + x*2 + (c-1)*2]
+                                            : planes[c][(y/pairRows)*buffers.rowStride[c] + x/2];
+                        int diff = AbsDiff(chroma, FloatYUV(c, r, g, b, 2*pairRows));
+                        maxDiff = (diff > maxDiff) ? diff : maxDiff;
+                    }
+                }
+            }
+            CHECK(maxDiff <= 1, "%s as %s differs by %d from the float matrix", names[n], FormatName(formats[f]), maxDiff);
+            FreeBitmapPixels(&pixels);
+            FreeImageBuffers(&buffers);
+        }
+    }
+    config.imageMemoryLimit = 0;
+}
+
+// Nanoseconds per byte of a simple loop, the unit of recorded conversion times
+static double ReferenceTime(void)
+{
+    static unsigned char buffer[1<<20];
+    double best = 0.;
+    for (int r = 0; r < 10; r++)
+    {
+        uint64_t start = NowNs();
+        uint32_t sum = 0;
+        for (unsigned int i = 0; i < sizeof(buffer); i++)
+        {
+            buffer[i] = (unsigned char)(buffer[i]*3 + i);
+            sum += buffer[i];
+        }
+        double time = (double)(NowNs() - start)/sizeof(buffer);
+        if (0 == r || time < best)
+            best = time;
+        if (sum == 1) // Keeps the loop
+            printf(" ");
+    }
+    return best;
+}
+
+static void TestConversionTimes(void)
+{
+    static const unsigned int bits[] = { 16, 24, 32 };
+    const unsigned int width = 320;
+    const unsigned int height = 240;
+    const int loads = 15;
+
+    char timingsPath[256];
+    snprintf(timingsPath, sizeof(timingsPath), "%s/golden/timings.csv", dataDir);
+
+    FILE* recorded = updateGolden ? NULL : fopen(timingsPath, "r");
+    FILE* output = updateGolden ? fopen(timingsPath, "w") : NULL;
+    CHECK(NULL != recorded || NULL != output, "can't open %s", timingsPath);
+    if (NULL != output)
+        fprintf(output, "format,bits,cost\n");
+    else if (NULL != recorded)
+        fscanf(recorded, "%*[^\n]\n");
+
+    double reference = ReferenceTime();
+    for (int b = 0; b < sizeof(bits)/sizeof(bits[0]); b++)
+    {
+        char bmpPath[128];
+        snprintf(bmpPath, sizeof(bmpPath), "%s/timing_%u.bmp", tempRoot, bits[b]);
+        WriteTestBMP(bmpPath, width, height, bits[b], 7);
+
+        for (int f = 0; f < NB_TEST_FORMATS; f++)
+        {
+            uint64_t best = 0;
+            for (int l = 0; l < loads; l++)
+            {
+                BitmapPixels pixels;
+                ImageBuffers buffers;
+                LoadStats stats;
+                uint64_t start = NowNs();
+                if (LoadTestImage(bmpPath, testFormats[f], &pixels, &buffers, &stats) < 0)
+                    break;
+                uint64_t time = NowNs() - start;
+                FreeBitmapPixels(&pixels);
+                FreeImageBuffers(&buffers);
+                if (0 == l || time < best)
+                    best = time;
+            }
+            // Cost of a pixel in reference loop bytes
+            double cost = (double)best/(width*height)/reference;
+            printf("time %s %u bits: %.2f ns/pixel, cost %.2f\n", FormatName(testFormats[f]), bits[b], (double)best/(width*height), cost);
+
+            if (NULL != output)
+                fprintf(output, "%s,%u,%.3f\n", FormatName(testFormats[f]), bits[b], cost);
+            else if (NULL != recorded)
+            {
+                char name[32];
+                unsigned int recordedBits;
+                double recordedCost;
+                int read = fscanf(recorded, "%31[^,],%u,%lf\n", name, &recordedBits, &recordedCost);
+                CHECK(3 == read && 0 == strcmp(name, FormatName(testFormats[f])) && recordedBits == bits[b], "%s doesn't match the tested cases", timingsPath);
+                if (3 == read && maxSlowdown > 0.)
+                    CHECK(cost <= recordedCost*maxSlowdown, "%s %u bits: cost %.2f instead of %.2f", FormatName(testFormats[f]), bits[b], cost, recordedCost);
+            }
+        }
+        remove(bmpPath);
+    }
+    if (NULL != output)
+        fclose(output);
+    if (NULL != recorded)
+        fclose(recorded);
+}
+
+static void TestFrameClock(void)
+{
+    static const int rates[] = { 3, 5, 7, 10, 15, 20, 30, 60, 120 };
+    uint32_t seed = 5;
+    for (int r = 0; r < sizeof(rates)/sizeof(rates[0]); r++)
+    {
+        framerate[0] = rates[r];
+        initTimeStamp[0] = 123456789;
+        uint64_t num, den;
+        FrameRateRatio(0, &num, &den);
+        CHECK(7 != rates[r] || (15 == num && 2 == den), "7 fps camera rate isn't 7.5 frames per second");
+
+        // Every num frames last exactly den seconds, even after 10 hours
+        for (uint64_t seconds = 0; seconds <= 36000; seconds += 600)
+        {
+            uint64_t frame = seconds*num/den + 1;
+            CHECK(FrameStart(0, frame) == initTimeStamp[0] + seconds*1000000, "%d fps: frame %llu doesn't start at %llu s", rates[r], (unsigned long long)frame, (unsigned long long)seconds);
+            CHECK(FrameAt(0, initTimeStamp[0] + seconds*1000000) == frame, "%d fps: wrong frame at %llu s", rates[r], (unsigned long long)seconds);
+        }
+
+        // Any time is in the frame starting at or before it and ending after it
+        for (int i = 0; i < 100000; i++)
+        {
+            seed = seed*1664525 + 1013904223;
+            uint64_t time = initTimeStamp[0] + (uint64_t)seed*9;
+            uint64_t frame = FrameAt(0, time);
+            CHECK(FrameStart(0, frame) <= time && time < FrameStart(0, frame+1), "%d fps: time %llu outside of frame %llu", rates[r],
+                  (unsigned long long)(time - initTimeStamp[0]), (unsigned long long)frame);
+        }
+    }
+}
+
+static void TestVirtualClockReads(void)
+{
+    static const int rates[] = { SCE_CAMERA_FRAMERATE_7_FPS, SCE_CAMERA_FRAMERATE_30_FPS };
+    CHECK(&virtualTimeSource == timeSource, "\"virtualClock\" setting ignored");
+    for (int r = 0; r < sizeof(rates)/sizeof(rates[0]); r++)
+    {
+        TestCamera camera;
+        if (OpenTestCamera(0, SCE_CAMERA_FORMAT_YUV422_PACKED, SCE_CAMERA_RESOLUTION_320_240, rates[r], &camera) < 0)
+        {
+            CHECK(0, "%d fps: camera opening failed", rates[r]);
+            continue;
+        }
+
+        // Read k reports frame k with the time stamp of its middle, whatever the read mode and the image loading
+        for (int k = 1; k <= 1000; k++)
+        {
+            SceCameraRead read;
+            int res = ReadTestCamera(0, k & 1, &read);
+            uint64_t expected = (FrameStart(0, k) + FrameStart(0, k+1))>>1;
+            CHECK(0 == res && 0 == read.status && k == read.frame && expected == read.timestamp, "%d fps read %d: frame %llu at %llu instead of %d at %llu",
+                  rates[r], k, (unsigned long long)read.frame, (unsigned long long)(read.timestamp - initTimeStamp[0]), k,
+                  (unsigned long long)(expected - initTimeStamp[0]));
+            if (0 != res || k != read.frame)
+                break;
+        }
+        CloseTestCamera(0, &camera);
+    }
+}
+
+static void TestBlockingReads(void)
+{
+    timeSource = &processTimeSource;
+    TestCamera camera;
+    if (OpenTestCamera(0, SCE_CAMERA_FORMAT_YUV420_PLANE, SCE_CAMERA_RESOLUTION_640_480, SCE_CAMERA_FRAMERATE_60_FPS, &camera) < 0 || WaitTestImage(0) < 0)
+        CHECK(0, "camera opening or image loading failed");
+    else
+    {
+        ImageLoadStats loadStats;
+        CHECK(0 == fakeCameraGetLoadStats(0, &loadStats) && 1 == loadStats.loads && 0 == loadStats.failures, "%u image loads, %u failed instead of 1 load",
+              loadStats.loads, loadStats.failures);
+        CHECK(-1 == fakeCameraGetLoadStats(NB_CAM, &loadStats), "load statistics of an invalid camera");
+        BlitStats blitStats;
+        CHECK(0 == fakeCameraGetBlitStats(0, &blitStats) && 0 == blitStats.hits + blitStats.updates + blitStats.rewrites && 0 == blitStats.copiedBytes,
+              "buffers writes of the previous camera session kept");
+
+        uint64_t lastFrame = 0;
+        for (int i = 0; i < 10; i++)
+        {
+            // A blocking read gives a new frame, a non blocking read right after it has none (unless the host was too slow)
+            SceCameraRead read;
+            int res = ReadTestCamera(0, 0, &read);
+            CHECK(0 == res && 0 == read.status && read.frame > lastFrame, "blocking read %d: frame %llu after %llu", i, (unsigned long long)read.frame, (unsigned long long)lastFrame);
+            CHECK(FrameStart(0, read.frame) <= read.timestamp && read.timestamp < FrameStart(0, read.frame+1), "blocking read %d: time stamp outside of frame %llu", i, (unsigned long long)read.frame);
+            lastFrame = read.frame;
+
+            res = ReadTestCamera(0, 1, &read);
+            CHECK(0 == res && ((2 == read.status && read.frame == lastFrame) || (0 == read.status && read.frame > lastFrame)),
+                  "non blocking read %d: status %d, frame %llu after %llu", i, read.status, (unsigned long long)read.frame, (unsigned long long)lastFrame);
+            lastFrame = read.frame;
+        }
+        CHECK(0 == fakeCameraGetBlitStats(0, &blitStats) && blitStats.rewrites > 0 && blitStats.copiedBytes > 0 && blitStats.hits + blitStats.updates + blitStats.rewrites <= 20,
+              "%u reads up to date, %u updated, %u rewritten, %llu bytes copied", blitStats.hits, blitStats.updates, blitStats.rewrites,
+              (unsigned long long)blitStats.copiedBytes);
+    }
+    CloseTestCamera(0, &camera);
+    timeSource = &virtualTimeSource;
+}
+
+static void TestY4MColorSpaces(void)
+{
+    static const char* accepted[] = { "420", "420jpeg W64", "420paldv", "420mpeg2" };
+    static const char* rejected[] = { "420p10", "420p16 W64", "422", "444", "mono", "42", "420jpegx" };
+    for (int i = 0; i < sizeof(accepted)/sizeof(accepted[0]); i++)
+        CHECK(IsY4M420ColorSpace(accepted[i]), "Y4M color space C%s rejected", accepted[i]);
+    for (int i = 0; i < sizeof(rejected)/sizeof(rejected[0]); i++)
+        CHECK(!IsY4M420ColorSpace(rejected[i]), "Y4M color space C%s accepted", rejected[i]);
+}
+
+#ifndef READ_WITH_KUIO
+static void TestTraceFile(void)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/data/FakeCamera/trace.bin", tempRoot);
+    FILE* file = fopen(path, "rb");
+    TraceHeader header;
+    if (NULL == file || 1 != fread(&header, sizeof(header), 1, file))
+    {
+        CHECK(0, "no trace file");
+        if (file)
+            fclose(file);
+        return;
+    }
+    CHECK(TRACE_MAGIC == header.magic && TRACE_VERSION == header.version && sizeof(TraceRecord) == header.recordSize, "invalid trace header");
+
+    // 3 camera sessions: 2 with the virtual clock, 1 with blocking reads
+    int counts[TRACE_IMAGE_LOAD+1] = { 0 };
+    uint32_t expected = 1;
+    TraceRecord record;
+    while (1 == fread(&record, sizeof(record), 1, file))
+    {
+        CHECK(expected == record.number, "trace record %u instead of %u", record.number, expected);
+        expected = record.number + 1;
+        if (record.event <= TRACE_IMAGE_LOAD)
+            counts[record.event]++;
+    }
+    fclose(file);
+    CHECK(3 == counts[TRACE_OPEN] && 3 == counts[TRACE_START] && 3 == counts[TRACE_STOP] && 3 == counts[TRACE_CLOSE],
+          "traced %d opens, %d starts, %d stops, %d closes instead of 3", counts[TRACE_OPEN], counts[TRACE_START], counts[TRACE_STOP], counts[TRACE_CLOSE]);
+    CHECK(2020 == counts[TRACE_READ], "%d traced reads instead of 2020", counts[TRACE_READ]);
+    CHECK(counts[TRACE_IMAGE_LOAD] > 0, "no traced image load");
+
+    if (traceOut)
+    {
+        char command[320];
+        snprintf(command, sizeof(command), "cp '%s' '%s'", path, traceOut);
+        CHECK(0 == system(command), "can't copy the trace to %s", traceOut);
+    }
+}
+#endif
+
+static int WriteTestConfig(const char* iText)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/data/FakeCamera/ALL.cfg", tempRoot);
+    return WriteWholeFile(path, iText, strlen(iText));
+}
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--update-golden"))
+            updateGolden = 1;
+        else if (0 == strcmp(argv[i], "--max-slowdown") && i+1 < argc)
+            maxSlowdown = atof(argv[++i]);
+        else if (0 == strcmp(argv[i], "--trace-out") && i+1 < argc)
+            traceOut = argv[++i];
+        else if (0 == strcmp(argv[i], "--golden-only"))
+            goldenOnly = 1;
+        else
+            dataDir = argv[i];
+    }
+    if (NULL == dataDir || NULL == MakeTempRoot())
+    {
+        fprintf(stderr, "Usage: %s DATA_DIR [--update-golden] [--max-slowdown FACTOR] [--trace-out PATH] [--golden-only]\n", argv[0]);
+        return 2;
+    }
+    char imagePath[128];
+    snprintf(imagePath, sizeof(imagePath), "%s/data/FakeCamera/ALL.bmp", tempRoot);
+    if (WriteTestConfig("imageCache=0\nvirtualClock=1\ntrace=1\n") < 0 || WriteTestBMP(imagePath, 320, 240, 24, 9) < 0)
+        return 2;
+    module_start(0, NULL);
+    int moduleBlocks = hostMemBlockCount();
+
+    TestGoldenImages();
+    if (goldenOnly)
+    {
+        TestYUVConversion();
+        module_stop(0, NULL);
+        printf("%s\n", failures ? "FAILED" : "OK");
+        return failures ? 1 : 0;
+    }
+    TestTruncatedImages();
+#ifndef READ_WITH_KUIO
+    TestImageCacheKey();
+    TestImageIndex();
+#endif
+    TestYUVConversion();
+    TestConversionTimes();
+    TestY4MColorSpaces();
+    CHECK(moduleBlocks == hostMemBlockCount(), "%d memory blocks leaked", hostMemBlockCount() - moduleBlocks);
+    TestFrameClock();
+    TestVirtualClockReads();
+    TestBlockingReads();
+    module_stop(0, NULL);
+    CHECK(0 == hostThreadCount(), "%d threads still running after module_stop", hostThreadCount());
+    CHECK(0 == hostMemBlockCount(), "%d memory blocks left after module_stop", hostMemBlockCount());
+#ifndef READ_WITH_KUIO
+    TestTraceFile();
+#endif
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
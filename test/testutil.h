@@ -0,0 +1,203 @@
+// Helpers shared by the host programs, included after main.c
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* FormatName(SceCameraFormat iFormat)
+{
+    switch (iFormat)
+    {
+        case SCE_CAMERA_FORMAT_ARGB: return "ARGB";
+        case SCE_CAMERA_FORMAT_ABGR: return "ABGR";
+        case SCE_CAMERA_FORMAT_YUV422_PACKED: return "YUV422_PACKED";
+        case SCE_CAMERA_FORMAT_YUV422_PLANE: return "YUV422_PLANE";
+        case SCE_CAMERA_FORMAT_YUV420_PLANE: return "YUV420_PLANE";
+        case SCE_CAMERA_FORMAT_RAW8: return "RAW8";
+        default: return "INVALID";
+    }
+}
+
+static uint64_t NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+// Temporary directory standing for "ux0:" with an empty "ux0:data/FakeCamera", removed at exit
+static char tempRoot[64];
+
+static void RemoveTempRoot(void)
+{
+    char command[96];
+    snprintf(command, sizeof(command), "rm -rf '%s'", tempRoot);
+    if (0 != system(command))
+        fprintf(stderr, "Can't remove %s\n", tempRoot);
+}
+
+static const char* MakeTempRoot(void)
+{
+    char path[128];
+    snprintf(tempRoot, sizeof(tempRoot), "/tmp/fakecamera_XXXXXX");
+    if (NULL == mkdtemp(tempRoot))
+        return NULL;
+    snprintf(path, sizeof(path), "%s/data", tempRoot);
+    mkdir(path, 0777);
+    snprintf(path, sizeof(path), "%s/data/FakeCamera", tempRoot);
+    mkdir(path, 0777);
+    hostSetRoot(tempRoot);
+    atexit(&RemoveTempRoot);
+    return tempRoot;
+}
+
+// Deterministic test picture: gradients with noise, and some black, white and saturated pixels
+static void TestPixel(unsigned int iX, unsigned int iY, unsigned int iWidth, unsigned int iHeight, uint32_t* ioSeed, unsigned char oBGRA[4])
+{
+    *ioSeed = *ioSeed*1664525 + 1013904223;
+    uint32_t noise = *ioSeed >> 8;
+    if (0 == (noise & 0xF))
+    {
+        // Extreme values for saturation and rounding
+        oBGRA[0] = (noise & 0x10) ? 0xFF : 0;
+        oBGRA[1] = (noise & 0x20) ? 0xFF : 0;
+        oBGRA[2] = (noise & 0x40) ? 0xFF : 0;
+    }
+    else
+    {
+        oBGRA[0] = (iX*255/(iWidth > 1 ? iWidth-1 : 1) + (noise & 0x1F)) & 0xFF;
+        oBGRA[1] = (iY*255/(iHeight > 1 ? iHeight-1 : 1) + ((noise>>5) & 0x1F)) & 0xFF;
+        oBGRA[2] = ((iX+iY)*4 + ((noise>>10) & 0x3F)) & 0xFF;
+    }
+    oBGRA[3] = (noise>>16) & 0xFF;
+}
+
+// Writes a bottom-up BMP file (16 bits pixels are BGR565 with bit fields, like the plugin reads them)
+static int WriteTestBMP(const char* iPath, unsigned int iWidth, unsigned int iHeight, unsigned int iBits, uint32_t iSeed)
+{
+    unsigned int rowStride = (iWidth*(iBits/8) + 3) & ~3;
+    unsigned int masksSize = (16 == iBits) ? 12 : 0;
+    BITMAPFILEHEADER fileHeader = { BMP_SIGNATURE, 0, 0, 0, 0 };
+    BITMAPINFOHEADER infoHeader;
+    memset(&infoHeader, 0, sizeof(infoHeader));
+    fileHeader.bfOffBits = sizeof(fileHeader) + sizeof(infoHeader) + masksSize;
+    fileHeader.bfSize = fileHeader.bfOffBits + rowStride*iHeight;
+    infoHeader.biSize = sizeof(infoHeader);
+    infoHeader.biWidth = iWidth;
+    infoHeader.biHeight = iHeight;
+    infoHeader.biPlanes = 1;
+    infoHeader.biBitCount = iBits;
+    infoHeader.biCompression = (16 == iBits) ? 3 : 0;
+    infoHeader.biSizeImage = rowStride*iHeight;
+
+    FILE* file = fopen(iPath, "wb");
+    if (NULL == file)
+        return -1;
+    fwrite(&fileHeader, sizeof(fileHeader), 1, file);
+    fwrite(&infoHeader, sizeof(infoHeader), 1, file);
+    if (16 == iBits)
+    {
+        static const uint32_t masks[3] = { 0xF800, 0x07E0, 0x001F };
+        fwrite(masks, sizeof(masks), 1, file);
+    }
+
+    unsigned char* row = calloc(rowStride, 1);
+    uint32_t seed = iSeed;
+    for (unsigned int y = 0; y < iHeight; y++)
+    {
+        for (unsigned int x = 0; x < iWidth; x++)
+        {
+            unsigned char bgra[4];
+            TestPixel(x, iHeight-1-y, iWidth, iHeight, &seed, bgra);
+            if (16 == iBits)
+            {
+                uint16_t color = ((bgra[2]>>3)<<11) | ((bgra[1]>>2)<<5) | (bgra[0]>>3);
+                memcpy(row + x*2, &color, 2);
+            }
+            else
+                memcpy(row + x*(iBits/8), bgra, iBits/8);
+        }
+        fwrite(row, rowStride, 1, file);
+    }
+    free(row);
+    return (0 == fclose(file)) ? 0 : -1;
+}
+
+// Loads a BMP file like the loader thread does (without the converted images cache)
+static int LoadTestImage(const char* iPath, SceCameraFormat iFormat, BitmapPixels* oPixels, ImageBuffers* oBuffers, LoadStats* oStats)
+{
+    BitmapPixels pixelsInit = BITMAP_PIXELS_INIT;
+    ImageBuffers buffersInit = IMAGE_BUFFERS_INIT;
+    *oPixels = pixelsInit;
+    *oBuffers = buffersInit;
+
+    SceUID fd = OpenFile(iPath);
+    if (fd < 0)
+        return -1;
+    char memname[] = "test";
+    int res = LoadBMPFile(fd, iPath, iFormat, memname, oPixels, oBuffers, oStats);
+    CloseFile(fd);
+    if (res < 0)
+    {
+        FreeBitmapPixels(oPixels);
+        FreeImageBuffers(oBuffers);
+    }
+    return res;
+}
+
+static inline unsigned int PlaneSize(const ImageBuffers* iBuffers, int iPlane)
+{
+    return iBuffers->rowStride[iPlane]*iBuffers->imageHeight/iBuffers->rowDepend[iPlane];
+}
+
+// Camera used through the hooks like a title does (module_start must have been called)
+typedef struct {
+    SceCameraInfo info;
+    void* planes[3];
+} TestCamera;
+
+static inline int OpenTestCamera(int iDevnum, SceCameraFormat iFormat, SceCameraResolution iResolution, int iFramerate, TestCamera* oCamera)
+{
+    memset(oCamera, 0, sizeof(TestCamera));
+    // Large enough for every format and resolution
+    for (int i = 0; i < 3; i++)
+        oCamera->planes[i] = calloc(640*480*4, 1);
+    oCamera->info.size = sizeof(SceCameraInfo);
+    oCamera->info.format = iFormat;
+    oCamera->info.resolution = iResolution;
+    oCamera->info.framerate = iFramerate;
+    oCamera->info.pIBase = oCamera->planes[0];
+    oCamera->info.pUBase = oCamera->planes[1];
+    oCamera->info.pVBase = oCamera->planes[2];
+    if (hook_sceCameraOpen(iDevnum, &oCamera->info) < 0)
+        return -1;
+    return hook_sceCameraStart(iDevnum);
+}
+
+static inline int ReadTestCamera(int iDevnum, int iMode, SceCameraRead* oRead)
+{
+    memset(oRead, 0, sizeof(SceCameraRead));
+    oRead->size = sizeof(SceCameraRead);
+    oRead->mode = iMode;
+    return hook_sceCameraRead(iDevnum, oRead);
+}
+
+static inline void CloseTestCamera(int iDevnum, TestCamera* ioCamera)
+{
+    hook_sceCameraStop(iDevnum);
+    hook_sceCameraClose(iDevnum);
+    for (int i = 0; i < 3; i++)
+        free(ioCamera->planes[i]);
+}
+
+// Waits for the camera image (up to 5 seconds)
+static inline int WaitTestImage(int iDevnum)
+{
+    for (int i = 0; i < 5000 && imageBuffers[iDevnum].ready <= 0; i++)
+        sceKernelDelayThread(1000);
+    return (imageBuffers[iDevnum].ready > 0) ? 0 : -1;
+}
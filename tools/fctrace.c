@@ -0,0 +1,217 @@
+// Decoder of the trace files written with the "trace" setting ("ux0:data/FakeCamera/trace.bin")
+// Prints the timeline of camera events (unless --stats is given), then the statistics of each event type: durations,
+// intervals between camera reads, repeated and skipped camera frames, and records lost by the trace thread
+// Usage: fctrace trace.bin [--stats]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same layout as in main.c (little-endian)
+#define TRACE_MAGIC   0x52544346 // "FCTR"
+#define TRACE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t startTime;
+} TraceHeader;
+
+typedef struct {
+    uint32_t number;
+    uint8_t event;
+    uint8_t devnum;
+    uint16_t reserved;
+    uint64_t timestamp;
+    uint32_t fakeFrame;
+    uint32_t bytes;
+    uint32_t duration;
+    int32_t result;
+} TraceRecord;
+
+#define NB_EVENTS 6
+#define NB_CAM    2
+
+static const char* eventNames[NB_EVENTS] = { "open", "close", "start", "stop", "read", "image_load" };
+
+// Growing array of samples
+typedef struct {
+    uint64_t* values;
+    unsigned int count;
+    unsigned int capacity;
+} Samples;
+
+static void AddSample(Samples* ioSamples, uint64_t iValue)
+{
+    if (ioSamples->count == ioSamples->capacity)
+    {
+        ioSamples->capacity = ioSamples->capacity ? 2*ioSamples->capacity : 256;
+        ioSamples->values = realloc(ioSamples->values, ioSamples->capacity*sizeof(uint64_t));
+    }
+    ioSamples->values[ioSamples->count++] = iValue;
+}
+
+static int CompareValues(const void* iValue1, const void* iValue2)
+{
+    uint64_t value1 = *(const uint64_t*)iValue1;
+    uint64_t value2 = *(const uint64_t*)iValue2;
+    return (value1 > value2) - (value1 < value2);
+}
+
+// Prints count, mean, median, 95th percentile and maximum (microseconds)
+static void PrintSamples(const char* iName, Samples* ioSamples)
+{
+    if (0 == ioSamples->count)
+        return;
+    qsort(ioSamples->values, ioSamples->count, sizeof(uint64_t), &CompareValues);
+    uint64_t sum = 0;
+    for (unsigned int i = 0; i < ioSamples->count; i++)
+        sum += ioSamples->values[i];
+    printf("  %-22s %8u samples, mean %10.1f us, p50 %8llu us, p95 %8llu us, max %8llu us\n", iName, ioSamples->count, (double)sum/ioSamples->count,
+           (unsigned long long)ioSamples->values[ioSamples->count/2], (unsigned long long)ioSamples->values[(ioSamples->count*95)/100],
+           (unsigned long long)ioSamples->values[ioSamples->count-1]);
+}
+
+typedef struct {
+    Samples durations[NB_EVENTS];
+    Samples readIntervals[NB_CAM];
+    uint64_t lastRead[NB_CAM];
+    uint32_t lastFrame[NB_CAM];
+    unsigned int newFrames[NB_CAM];
+    unsigned int repeatedFrames[NB_CAM];
+    unsigned int skippedFrames[NB_CAM];
+    uint64_t readBytes[NB_CAM];
+    uint64_t loadBytes;
+    unsigned int failures[NB_EVENTS];
+    unsigned int lostRecords;
+    unsigned int records;
+} TraceStats;
+
+static void AddRecord(TraceStats* ioStats, const TraceRecord* iRecord)
+{
+    ioStats->records++;
+    AddSample(&ioStats->durations[iRecord->event], iRecord->duration);
+    if (iRecord->result < 0)
+        ioStats->failures[iRecord->event]++;
+
+    int devnum = iRecord->devnum;
+    if (4 == iRecord->event && devnum < NB_CAM)
+    {
+        if (0 != ioStats->lastRead[devnum])
+            AddSample(&ioStats->readIntervals[devnum], iRecord->timestamp - ioStats->lastRead[devnum]);
+        ioStats->lastRead[devnum] = iRecord->timestamp;
+
+        if (iRecord->fakeFrame == ioStats->lastFrame[devnum])
+            ioStats->repeatedFrames[devnum]++;
+        else
+        {
+            ioStats->newFrames[devnum]++;
+            if (0 != ioStats->lastFrame[devnum] && iRecord->fakeFrame > ioStats->lastFrame[devnum]+1)
+                ioStats->skippedFrames[devnum] += iRecord->fakeFrame - ioStats->lastFrame[devnum] - 1;
+        }
+        ioStats->lastFrame[devnum] = iRecord->fakeFrame;
+        ioStats->readBytes[devnum] += iRecord->bytes;
+    }
+    else if (2 == iRecord->event && devnum < NB_CAM)
+    {
+        // Frames are counted again from 1 on each camera start
+        ioStats->lastRead[devnum] = 0;
+        ioStats->lastFrame[devnum] = 0;
+    }
+    else if (5 == iRecord->event)
+        ioStats->loadBytes += iRecord->bytes;
+}
+
+static void PrintStats(TraceStats* ioStats)
+{
+    printf("%u records, %u lost\n", ioStats->records, ioStats->lostRecords);
+    printf("durations:\n");
+    for (int i = 0; i < NB_EVENTS; i++)
+        PrintSamples(eventNames[i], &ioStats->durations[i]);
+    for (int i = 0; i < NB_EVENTS; i++)
+    {
+        if (ioStats->failures[i] > 0)
+            printf("  %s: %u failed\n", eventNames[i], ioStats->failures[i]);
+    }
+    for (int i = 0; i < NB_CAM; i++)
+    {
+        if (0 == ioStats->newFrames[i] && 0 == ioStats->repeatedFrames[i])
+            continue;
+        printf("camera %d reads: %u new frames, %u repeated frames, %u skipped frames, %llu bytes copied\n", i, ioStats->newFrames[i],
+               ioStats->repeatedFrames[i], ioStats->skippedFrames[i], (unsigned long long)ioStats->readBytes[i]);
+        PrintSamples("interval", &ioStats->readIntervals[i]);
+    }
+    if (ioStats->durations[5].count > 0)
+        printf("image loads: %llu bytes converted\n", (unsigned long long)ioStats->loadBytes);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = NULL;
+    int timeline = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--stats"))
+            timeline = 0;
+        else
+            path = argv[i];
+    }
+    if (NULL == path)
+    {
+        fprintf(stderr, "Usage: %s trace.bin [--stats]\n", argv[0]);
+        return 2;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (NULL == file)
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        return 1;
+    }
+
+    TraceHeader header;
+    if (1 != fread(&header, sizeof(header), 1, file) || TRACE_MAGIC != header.magic || TRACE_VERSION != header.version
+        || sizeof(TraceRecord) != header.recordSize)
+    {
+        fprintf(stderr, "%s isn't a version %d trace file\n", path, TRACE_VERSION);
+        fclose(file);
+        return 1;
+    }
+
+    if (timeline)
+        printf("%12s %3s %-10s %8s %10s %8s %11s\n", "time_ms", "dev", "event", "frame", "bytes", "us", "result");
+
+    static TraceStats stats;
+    TraceRecord record;
+    uint32_t expected = 1;
+    int res = 0;
+    while (1 == fread(&record, sizeof(record), 1, file))
+    {
+        if (record.event >= NB_EVENTS || record.number < expected)
+        {
+            fprintf(stderr, "Invalid record %u\n", record.number);
+            res = 1;
+            break;
+        }
+        if (record.number > expected)
+        {
+            stats.lostRecords += record.number - expected;
+            if (timeline)
+                printf("%12s %u records lost\n", "--", record.number - expected);
+        }
+        expected = record.number + 1;
+
+        if (timeline)
+            printf("%12.3f %3u %-10s %8u %10u %8u %11d\n", (double)(int64_t)(record.timestamp - header.startTime)/1000., record.devnum,
+                   eventNames[record.event], record.fakeFrame, record.bytes, record.duration, record.result);
+        AddRecord(&stats, &record);
+    }
+    fclose(file);
+
+    if (timeline)
+        printf("\n");
+    PrintStats(&stats);
+    return res;
+}